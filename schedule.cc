@@ -25,7 +25,9 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SO
 #include <sstream>
 #include <time.h>
 #include <map>
+#include <limits>
 #include "schedule_lib.h"
+#include "schedule_output.h"
 
 using namespace std;
 
@@ -64,12 +66,30 @@ int read_time(const string& s1, const string& s2, const string& suffix) {
     return part1 * 3600 + part2 * 60;
 }
 
-bool set_task_time(const string &s, TimeSegment *t) {
-    regex pattern("([\\+~><=\\$xcl]?)(\\d+):?(\\d+)?([smhap]?)");
-    auto words_begin = sregex_iterator(s.begin(), s.end(), pattern);
-    auto words_end = sregex_iterator();
+// Time ranges like 9:00-11:30a following the given prefix, e.g. @ or !.
+vector<pair<int, int> > read_time_ranges(const string& s, char prefix, string* pattern) {
+    static const regex range_pattern("([@!])(\\d+):(\\d+)([ap]?)-(\\d+):(\\d+)([ap]?)");
+    vector<pair<int, int> > ranges;
+    for (auto it = sregex_iterator(s.begin(), s.end(), range_pattern); it != sregex_iterator(); ++it) {
+        smatch sm = *it;
+        if (sm[1].str()[0] != prefix) continue;
+        ranges.push_back(make_pair(read_time(sm[2].str(), sm[3].str(), sm[4].str()), read_time(sm[5].str(), sm[6].str(), sm[7].str())));
+        if (pattern != nullptr) *pattern += sm[0].str() + " ";
+    }
+    return ranges;
+}
+
+bool set_task_time(const string &str, TimeSegment *t) {
+    static const regex pattern("([\\+~><=\\$xcl]?)(\\d+):?(\\d+)?([smhap]?)");
+    static const regex window_pattern("@\\d+:\\d+[ap]?-\\d+:\\d+[ap]?");
 
     t->pattern = "";
+    // Availability windows: the task runs within one of them.
+    vector<pair<int, int> > windows = read_time_ranges(str, '@', &t->pattern);
+    const string s = regex_replace(str, window_pattern, " ");
+
+    auto words_begin = sregex_iterator(s.begin(), s.end(), pattern);
+    auto words_end = sregex_iterator();
 
     int start_time = -1;
     int uncertainty = 0;
@@ -145,10 +165,20 @@ bool set_task_time(const string &s, TimeSegment *t) {
     t->cool_down = cool_down;
     t->deadline = deadline;
     t->priority = priority;
+    t->uncertainty = uncertainty;
 
     if (start_time >= 0) {
         // Start time and duration.
         t->start_time_intervals.push_back(make_pair(start_time - uncertainty, start_time + uncertainty));
+    } else if (!windows.empty()) {
+        // Start early enough to end within the window, and within > and < if given.
+        for (const auto& w : windows) {
+            int lo = max(w.first, after);
+            int hi = w.second - duration;
+            if (before >= 0) hi = min(hi, before);
+            // An empty window is dropped by build_calendar.
+            t->start_time_intervals.push_back(make_pair(lo, hi));
+        }
     } else if (after >= 0) {
         t->start_time_intervals.push_back(make_pair(after, numeric_limits<int>::max()));
     } else if (before >= 0) {
@@ -158,7 +188,7 @@ bool set_task_time(const string &s, TimeSegment *t) {
 }
 
 void set_task_labels(const string& dep_str, Task *task) {
-    regex pattern("([#,])([A-Za-z0-9\\-_]+)");
+    static const regex pattern("([#,])([A-Za-z0-9\\-_]+)");
     auto words_begin = sregex_iterator(dep_str.begin(), dep_str.end(), pattern);
     auto words_end = sregex_iterator();
 
@@ -207,9 +237,46 @@ void compute_task_indices(Tasks *tasks) {
     }
 }
 
+// Options follow the task list, e.g. --engine=dp --threads=4
+bool set_option(const string& option, Tasks *tasks) {
+    size_t eq = option.find('=');
+    if (eq == string::npos) return false;
+    string key = option.substr(0, eq);
+    string value = option.substr(eq + 1);
+
+    if (key == "--engine") {
+        if (value == "astar") tasks->engine = Tasks::ASTAR;
+        else if (value == "dp") tasks->engine = Tasks::DP;
+        else if (value == "portfolio") tasks->engine = Tasks::PORTFOLIO;
+        else if (value == "lns") tasks->engine = Tasks::LNS;
+        else return false;
+    } else if (key == "--threads") {
+        tasks->num_threads = stoi(value);
+    } else if (key == "--max_heap_size") {
+        tasks->max_heap_size = stoi(value);
+    } else if (key == "--time_budget") {
+        tasks->time_budget_ms = stoi(value);
+    } else if (key == "--decompose") {
+        tasks->decompose = stoi(value) != 0;
+    } else if (key == "--compact") {
+        tasks->compact_nodes = stoi(value) != 0;
+    } else if (key == "--quantum") {
+        tasks->time_quantum = stoi(value);
+    } else if (key == "--spill") {
+        tasks->spill_open_list = stoi(value) != 0;
+    } else if (key == "--robustness") {
+        tasks->robustness_samples = stoi(value);
+    } else if (key == "--duration_noise") {
+        tasks->duration_noise = stof(value);
+    } else {
+        return false;
+    }
+    return true;
+}
+
 int main(int argc, char *argv[]) {
     if (argc <= 1) {
-        cout << "Usage: schedule_new strings to specify the events." << endl;
+        cout << "Usage: schedule_new strings to specify the events. [--engine=astar|dp|lns|portfolio] [--threads=N] [--max_heap_size=N] [--spill=0|1] [--time_budget=ms] [--decompose=0|1] [--compact=0|1] [--quantum=s] [--robustness=N] [--duration_noise=r] [--format=table|json|csv|binary]" << endl;
         return 0;
     }
 
@@ -245,6 +312,18 @@ int main(int argc, char *argv[]) {
     tasks.global_start_time = hour * 3600 + minute * 60 + seconds;
     tasks.rest_time = 300;
 
+    ScheduleWriter::Format format = ScheduleWriter::TABLE;
+    for (int i = 2; i < argc; ++i) {
+        const string option = argv[i];
+        bool known = option.compare(0, 9, "--format=") == 0 ? ScheduleWriter::ParseFormat(option.substr(9), &format) : set_option(option, &tasks);
+        if (!known) {
+            cout << "Unknown option: " << argv[i] << endl;
+            return 1;
+        }
+    }
+    // Machine-readable output owns stdout, everything else goes to stderr.
+    if (format != ScheduleWriter::TABLE) cout.rdbuf(cerr.rdbuf());
+
     cout << "Current time: " << convert_to_time(tasks.global_start_time) << endl;
 
     regex pattern("\\[(.*?)\\](\\[(.*?)\\])?\\s+(.*?)$");
@@ -259,6 +338,12 @@ int main(int argc, char *argv[]) {
         string dep_str = sm[3].str(); 
         string name = sm[4].str();
 
+        // Busy time, e.g. [!12:00-13:00] Lunch
+        if (!time_str.empty() && time_str[0] == '!') {
+            for (const auto& range : read_time_ranges(time_str, '!', nullptr)) tasks.busy_intervals.push_back(range);
+            continue;
+        }
+
         Task task;
         task.name = name; 
         trim(task.name);
@@ -270,6 +355,7 @@ int main(int argc, char *argv[]) {
     }
 
     compute_task_indices(&tasks);
+    build_calendar(&tasks);
 
     cout << tasks.get_summary() << endl;
 
@@ -277,6 +363,10 @@ int main(int argc, char *argv[]) {
     if (make_schedule(tasks, &schedules)) {
         // print schedules
         cout << "#steps = " << schedules.search_steps << endl;
+        cout << "Engine: " << get_engine_name(schedules.engine) << (schedules.proven_optimal ? " (optimal)" : "") << endl;
+        if (schedules.spill_bytes_written > 0) {
+            cout << "Spill: " << schedules.spill_bytes_written << " bytes written, " << schedules.spill_bytes_read << " bytes read" << endl;
+        }
         for (int i = 0; i < schedules.schedules.size(); ++i) {
             const Schedule& schedule = schedules.schedules[i];
             const Task& task = tasks.tasks[schedule.idx]; 
@@ -289,6 +379,24 @@ int main(int argc, char *argv[]) {
             }
         } 
         cout << "Utility: " << schedules.used_duration << "/" << schedules.total_duration << "(" << 100 * schedules.used_duration / schedules.total_duration << "%)" << endl;
+
+        if (format != ScheduleWriter::TABLE) {
+            ScheduleWriter writer(format);
+            writer.Write(tasks, schedules);
+            writer.Flush();
+        }
+
+        Robustness robustness;
+        if (tasks.robustness_samples > 0 && evaluate_robustness(tasks, schedules, &robustness)) {
+            cout << "End p50/p90/p99: " << convert_to_time(tasks.global_start_time + robustness.makespan_p50) << " / "
+                 << convert_to_time(tasks.global_start_time + robustness.makespan_p90) << " / "
+                 << convert_to_time(tasks.global_start_time + robustness.makespan_p99) << endl;
+            for (int i = 0; i < schedules.schedules.size(); ++i) {
+                const Task& task = tasks.tasks[schedules.schedules[i].idx];
+                if (task.time.deadline <= 0) continue;
+                cout << "Deadline miss: " << task.name << " " << fixed << setprecision(1) << 100 * robustness.deadline_miss[i] << "%" << endl;
+            }
+        }
     }
     return 0;
 }
@@ -0,0 +1,143 @@
+/*
+Copyright (c) 2016 by Yuandong Tian
+
+Permission is hereby granted, free of charge, to any person obtaining a copy 
+of this software and associated documentation files (the "Software"), to deal 
+in the Software without restriction, including without limitation the rights 
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies 
+of the Software, and to permit persons to whom the Software is furnished to do so, 
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included 
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL 
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+// Microbenchmark of the start time kernel used by every A* expansion, on its own and as part
+// of whole expansions (pre-req pass, start times, lower bound of every child) in A*.
+// Usage: schedule_bench [#expansions] [A* budget in ms]
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <sstream>
+#include <vector>
+#include <cstdlib>
+#include "schedule_kernel.h"
+
+using namespace std;
+
+// Random day of tasks: 8:00 start, windows and deadlines within the day, and every fourth
+// task waits for an earlier one.
+Tasks make_random_tasks(int N, mt19937* rng) {
+    Tasks tasks;
+    tasks.global_start_time = 8 * 3600;
+    tasks.rest_time = 300;
+    uniform_int_distribution<int> minute(8 * 60, 22 * 60);
+    uniform_int_distribution<int> kind(0, 3);
+    for (int i = 0; i < N; ++i) {
+        Task task;
+        task.idx = i;
+        task.time.duration = (1 + (*rng)() % 12) * 300;
+        const int k = kind(*rng);
+        if (k == 1 || k == 3) task.time.deadline = minute(*rng) * 60;
+        if (k >= 2) {
+            const int lo = minute(*rng) * 60;
+            task.time.start_time_intervals.push_back(make_pair(lo, lo + 3600));
+        }
+        if (i > 0 && (*rng)() % 4 == 0) task.pre_req_indices.push_back((*rng)() % i);
+        tasks.tasks.push_back(task);
+    }
+    return tasks;
+}
+
+// Nanoseconds per A* expansion in a search of budget_ms.
+double time_expansions(Tasks tasks, int budget_ms) {
+    tasks.engine = Tasks::ASTAR;
+    tasks.decompose = false;
+    tasks.time_budget_ms = budget_ms;
+    tasks.max_heap_size = 2000;
+
+    // The search logs to cout.
+    ostringstream log;
+    streambuf* cout_buf = cout.rdbuf(log.rdbuf());
+    Schedules schedules;
+    auto start = chrono::steady_clock::now();
+    make_schedule(tasks, &schedules);
+    const double ns = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+    cout.rdbuf(cout_buf);
+    return ns / max(schedules.search_steps, 1);
+}
+
+int main(int argc, char* argv[]) {
+    const int num_expansions = argc > 1 ? atoi(argv[1]) : 20000;
+    const int budget_ms = argc > 2 ? atoi(argv[2]) : 500;
+    mt19937 rng(1);
+    cout << "Kernel: " << get_kernel_name() << endl;
+    cout << "Start times of all tasks, kernel only:" << endl;
+    cout << setw(8) << "#Task" << setw(14) << "scalar(ns)" << setw(14) << "kernel(ns)" << setw(10) << "speedup" << endl;
+
+    for (int N : {16, 64, 256, 1024, 4096}) {
+        Tasks tasks = make_random_tasks(N, &rng);
+        TaskKernelData data(tasks);
+
+        // A few nodes: some tasks scheduled (-1), the rest ready at some time of the day.
+        const int num_nodes = 16;
+        vector<vector<int> > ready(num_nodes, vector<int>(N));
+        vector<int> bases(num_nodes);
+        uniform_int_distribution<int> second(8 * 3600, 20 * 3600);
+        for (int j = 0; j < num_nodes; ++j) {
+            bases[j] = second(rng);
+            for (int i = 0; i < N; ++i) ready[j][i] = rng() % 4 == 0 ? -1 : second(rng);
+        }
+
+        vector<int> starts(N), expected(N);
+        long long checksum[2] = {0, 0};
+        double ns[2];
+        for (int pass = 0; pass < 2; ++pass) {
+            auto start = chrono::steady_clock::now();
+            for (int e = 0; e < num_expansions; ++e) {
+                const int j = e % num_nodes;
+                if (pass == 0) get_earliest_starts_scalar(data, ready[j].data(), bases[j], tasks.rest_time, starts.data());
+                else get_earliest_starts(data, ready[j].data(), bases[j], tasks.rest_time, starts.data());
+                checksum[pass] += starts[e % N];
+            }
+            ns[pass] = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / num_expansions;
+        }
+
+        // Both paths must agree on every task.
+        for (int j = 0; j < num_nodes; ++j) {
+            get_earliest_starts_scalar(data, ready[j].data(), bases[j], tasks.rest_time, expected.data());
+            get_earliest_starts(data, ready[j].data(), bases[j], tasks.rest_time, starts.data());
+            if (starts != expected || checksum[0] != checksum[1]) {
+                cout << "Mismatch for #Task = " << N << endl;
+                return 1;
+            }
+        }
+
+        cout << setw(8) << N << setw(14) << fixed << setprecision(1) << ns[0] << setw(14) << ns[1]
+             << setw(9) << setprecision(2) << ns[0] / ns[1] << "x" << endl;
+    }
+
+    // The same search with either kernel, so both expand the same nodes in the same order.
+    cout << "Whole A* expansions in " << budget_ms << "ms:" << endl;
+    cout << setw(8) << "#Task" << setw(14) << "scalar(ns)" << setw(14) << "kernel(ns)" << setw(10) << "speedup" << endl;
+    for (int N : {16, 64, 256, 1024}) {
+        Tasks tasks = make_random_tasks(N, &rng);
+        double ns[2];
+        for (int pass = 0; pass < 2; ++pass) {
+            set_scalar_kernels(pass == 0);
+            ns[pass] = time_expansions(tasks, budget_ms);
+        }
+        cout << setw(8) << N << setw(14) << fixed << setprecision(1) << ns[0] << setw(14) << ns[1]
+             << setw(9) << setprecision(2) << ns[0] / ns[1] << "x" << endl;
+    }
+    return 0;
+}
@@ -0,0 +1,208 @@
+/*
+Copyright (c) 2016 by Yuandong Tian
+
+Permission is hereby granted, free of charge, to any person obtaining a copy 
+of this software and associated documentation files (the "Software"), to deal 
+in the Software without restriction, including without limitation the rights 
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies 
+of the Software, and to permit persons to whom the Software is furnished to do so, 
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included 
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL 
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "schedule_kernel.h"
+
+#include <algorithm>
+#include <limits>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SCHEDULE_KERNEL_X86
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+TaskKernelData::TaskKernelData(const Tasks& tasks) : n(tasks.tasks.size()) {
+    earliest.resize(n);
+    latest.resize(n);
+    for (int i = 0; i < n; ++i) {
+        const TimeSegment& time = tasks.tasks[i].time;
+        earliest[i] = numeric_limits<int>::min();
+        latest[i] = time.deadline > 0 ? time.deadline - time.duration : numeric_limits<int>::max();
+        if (!time.start_time_intervals.empty()) {
+            earliest[i] = time.start_time_intervals.front().first;
+            latest[i] = min(latest[i], time.start_time_intervals.back().second);
+        }
+        if (time.start_time_intervals.size() > 1) multi_window.push_back(i);
+    }
+}
+
+static inline int get_earliest_start(const TaskKernelData& data, int i, int ready, int base, int rest) {
+    const int s = max(base, ready) + rest;
+    return ready < 0 || s > data.latest[i] ? -1 : max(s, data.earliest[i]);
+}
+
+void get_earliest_starts_scalar(const TaskKernelData& data, const int* ready, int base, int rest, int* starts) {
+    for (int i = 0; i < data.n; ++i) starts[i] = get_earliest_start(data, i, ready[i], base, rest);
+}
+
+// Monte Carlo lanes, one sample per lane.
+static void max_add_lanes_scalar(int n, const float* x, float add, float* acc) {
+    for (int s = 0; s < n; ++s) acc[s] = max(acc[s], x[s] + add);
+}
+
+static void finish_lanes_scalar(int n, float release, const float* jitter, const float* ready, float duration, const float* factor, float* end) {
+    for (int s = 0; s < n; ++s) end[s] = max(release + jitter[s], ready[s]) + duration * factor[s];
+}
+
+#ifdef SCHEDULE_KERNEL_X86
+
+// Failed lanes are all ones, so or-ing the mask into the start gives -1.
+__attribute__((target("avx2")))
+static void get_earliest_starts_avx2(const TaskKernelData& data, const int* ready, int base, int rest, int* starts) {
+    const __m256i base8 = _mm256_set1_epi32(base);
+    const __m256i rest8 = _mm256_set1_epi32(rest);
+    const __m256i zero8 = _mm256_setzero_si256();
+    int i = 0;
+    for (; i + 8 <= data.n; i += 8) {
+        const __m256i r = _mm256_loadu_si256((const __m256i*)(ready + i));
+        const __m256i s = _mm256_add_epi32(_mm256_max_epi32(base8, r), rest8);
+        const __m256i latest = _mm256_loadu_si256((const __m256i*)(data.latest.data() + i));
+        const __m256i earliest = _mm256_loadu_si256((const __m256i*)(data.earliest.data() + i));
+        const __m256i fail = _mm256_or_si256(_mm256_cmpgt_epi32(zero8, r), _mm256_cmpgt_epi32(s, latest));
+        _mm256_storeu_si256((__m256i*)(starts + i), _mm256_or_si256(_mm256_max_epi32(s, earliest), fail));
+    }
+    for (; i < data.n; ++i) starts[i] = get_earliest_start(data, i, ready[i], base, rest);
+}
+
+// SSE2 has no signed 32-bit max.
+static inline __m128i max_epi32_sse2(__m128i a, __m128i b) {
+    const __m128i gt = _mm_cmpgt_epi32(a, b);
+    return _mm_or_si128(_mm_and_si128(gt, a), _mm_andnot_si128(gt, b));
+}
+
+__attribute__((target("sse2")))
+static void get_earliest_starts_sse2(const TaskKernelData& data, const int* ready, int base, int rest, int* starts) {
+    const __m128i base4 = _mm_set1_epi32(base);
+    const __m128i rest4 = _mm_set1_epi32(rest);
+    const __m128i zero4 = _mm_setzero_si128();
+    int i = 0;
+    for (; i + 4 <= data.n; i += 4) {
+        const __m128i r = _mm_loadu_si128((const __m128i*)(ready + i));
+        const __m128i s = _mm_add_epi32(max_epi32_sse2(base4, r), rest4);
+        const __m128i latest = _mm_loadu_si128((const __m128i*)(data.latest.data() + i));
+        const __m128i earliest = _mm_loadu_si128((const __m128i*)(data.earliest.data() + i));
+        const __m128i fail = _mm_or_si128(_mm_cmpgt_epi32(zero4, r), _mm_cmpgt_epi32(s, latest));
+        _mm_storeu_si128((__m128i*)(starts + i), _mm_or_si128(max_epi32_sse2(s, earliest), fail));
+    }
+    for (; i < data.n; ++i) starts[i] = get_earliest_start(data, i, ready[i], base, rest);
+}
+
+__attribute__((target("avx2")))
+static void max_add_lanes_avx2(int n, const float* x, float add, float* acc) {
+    const __m256 add8 = _mm256_set1_ps(add);
+    int s = 0;
+    for (; s + 8 <= n; s += 8) {
+        _mm256_storeu_ps(acc + s, _mm256_max_ps(_mm256_loadu_ps(acc + s), _mm256_add_ps(_mm256_loadu_ps(x + s), add8)));
+    }
+    max_add_lanes_scalar(n - s, x + s, add, acc + s);
+}
+
+__attribute__((target("avx2")))
+static void finish_lanes_avx2(int n, float release, const float* jitter, const float* ready, float duration, const float* factor, float* end) {
+    const __m256 release8 = _mm256_set1_ps(release);
+    const __m256 duration8 = _mm256_set1_ps(duration);
+    int s = 0;
+    for (; s + 8 <= n; s += 8) {
+        const __m256 start = _mm256_max_ps(_mm256_add_ps(release8, _mm256_loadu_ps(jitter + s)), _mm256_loadu_ps(ready + s));
+        _mm256_storeu_ps(end + s, _mm256_add_ps(start, _mm256_mul_ps(duration8, _mm256_loadu_ps(factor + s))));
+    }
+    finish_lanes_scalar(n - s, release, jitter + s, ready + s, duration, factor + s, end + s);
+}
+
+__attribute__((target("sse2")))
+static void max_add_lanes_sse2(int n, const float* x, float add, float* acc) {
+    const __m128 add4 = _mm_set1_ps(add);
+    int s = 0;
+    for (; s + 4 <= n; s += 4) {
+        _mm_storeu_ps(acc + s, _mm_max_ps(_mm_loadu_ps(acc + s), _mm_add_ps(_mm_loadu_ps(x + s), add4)));
+    }
+    max_add_lanes_scalar(n - s, x + s, add, acc + s);
+}
+
+__attribute__((target("sse2")))
+static void finish_lanes_sse2(int n, float release, const float* jitter, const float* ready, float duration, const float* factor, float* end) {
+    const __m128 release4 = _mm_set1_ps(release);
+    const __m128 duration4 = _mm_set1_ps(duration);
+    int s = 0;
+    for (; s + 4 <= n; s += 4) {
+        const __m128 start = _mm_max_ps(_mm_add_ps(release4, _mm_loadu_ps(jitter + s)), _mm_loadu_ps(ready + s));
+        _mm_storeu_ps(end + s, _mm_add_ps(start, _mm_mul_ps(duration4, _mm_loadu_ps(factor + s))));
+    }
+    finish_lanes_scalar(n - s, release, jitter + s, ready + s, duration, factor + s, end + s);
+}
+
+#endif
+
+typedef void (*KernelFunc)(const TaskKernelData&, const int*, int, int, int*);
+typedef void (*MaxAddFunc)(int, const float*, float, float*);
+typedef void (*FinishFunc)(int, float, const float*, const float*, float, const float*, float*);
+
+struct KernelChoice {
+    KernelFunc func;
+    MaxAddFunc max_add;
+    FinishFunc finish;
+    const char* name;
+
+    KernelChoice(bool simd) : func(get_earliest_starts_scalar), max_add(max_add_lanes_scalar), finish(finish_lanes_scalar), name("scalar") {
+#ifdef SCHEDULE_KERNEL_X86
+        if (!simd) return;
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            func = get_earliest_starts_avx2;
+            max_add = max_add_lanes_avx2;
+            finish = finish_lanes_avx2;
+            name = "avx2";
+        } else if (__builtin_cpu_supports("sse2")) {
+            func = get_earliest_starts_sse2;
+            max_add = max_add_lanes_sse2;
+            finish = finish_lanes_sse2;
+            name = "sse2";
+        }
+#endif
+    }
+};
+
+static KernelChoice& get_kernel_choice() {
+    static KernelChoice choice(true);
+    return choice;
+}
+
+void set_scalar_kernels(bool scalar) {
+    get_kernel_choice() = KernelChoice(!scalar);
+}
+
+void get_earliest_starts(const TaskKernelData& data, const int* ready, int base, int rest, int* starts) {
+    get_kernel_choice().func(data, ready, base, rest, starts);
+}
+
+void max_add_lanes(int n, const float* x, float add, float* acc) {
+    get_kernel_choice().max_add(n, x, add, acc);
+}
+
+void finish_lanes(int n, float release, const float* jitter, const float* ready, float duration, const float* factor, float* end) {
+    get_kernel_choice().finish(n, release, jitter, ready, duration, factor, end);
+}
+
+const char* get_kernel_name() {
+    return get_kernel_choice().name;
+}
@@ -0,0 +1,63 @@
+/*
+Copyright (c) 2016 by Yuandong Tian
+
+Permission is hereby granted, free of charge, to any person obtaining a copy 
+of this software and associated documentation files (the "Software"), to deal 
+in the Software without restriction, including without limitation the rights 
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies 
+of the Software, and to permit persons to whom the Software is furnished to do so, 
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included 
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL 
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef _SCHEDULE_KERNEL_H_
+#define _SCHEDULE_KERNEL_H_
+
+#include <vector>
+#include "schedule_lib.h"
+
+// Static data of the start time test of earliest_given_constraint, as structure of arrays.
+// A task may start at s (before moving into its window) if s <= latest, and then starts at
+// max(s, earliest). latest folds the deadline and the end of the start window together.
+struct TaskKernelData {
+    int n;
+    std::vector<int> earliest, latest;
+
+    // Tasks with more than one start window. The kernel only uses the first and the last
+    // window, the caller has to apply the windows itself.
+    std::vector<int> multi_window;
+
+    TaskKernelData(const Tasks& tasks);
+};
+
+// For each task i: -1 if ready[i] < 0 (the task cannot be scheduled next), else the earliest
+// start of the task at or after max(base, ready[i]) + rest, or -1 if it does not fit.
+void get_earliest_starts(const TaskKernelData& data, const int* ready, int base, int rest, int* starts);
+
+// Same, always with the scalar code.
+void get_earliest_starts_scalar(const TaskKernelData& data, const int* ready, int base, int rest, int* starts);
+
+// Monte Carlo kernels over n samples (see evaluate_robustness), one sample per lane.
+// acc[s] = max(acc[s], x[s] + add)
+void max_add_lanes(int n, const float* x, float add, float* acc);
+
+// end[s] = max(release + jitter[s], ready[s]) + duration * factor[s]
+void finish_lanes(int n, float release, const float* jitter, const float* ready, float duration, const float* factor, float* end);
+
+// Name of the code path used by the kernels (avx2, sse2 or scalar).
+const char* get_kernel_name();
+
+// Use the scalar code in all kernels, or go back to the best one for the CPU. Not thread
+// safe; for schedule_bench, which compares both.
+void set_scalar_kernels(bool scalar);
+
+#endif
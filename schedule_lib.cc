@@ -20,6 +20,8 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SO
 */
 
 #include "schedule_lib.h"
+#include "schedule_kernel.h"
+#include "schedule_output.h"
 
 #include <queue>
 #include <vector>
@@ -32,17 +34,23 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SO
 #include <limits>
 #include <time.h>
 #include <set>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
 
 using namespace std;
 
 string convert_to_time(int t) {
-    int hour = t / 3600;
-    int minute = (t - hour * 3600) / 60;
-    int second = t % 60;
-    stringstream ss;
-    // ss << setfill('0') << setw(2) << hour << ":" << setw(2) << minute << ":" << setw(2) << second;
-    ss << setfill('0') << setw(2) << hour << ":" << setw(2) << minute;
-    return ss.str();
+    char buf[48];
+    return string(buf, write_time(buf, t));
 }
 
 /////////////////////////////////Heap////////////////////////////////////////////
@@ -212,35 +220,152 @@ void test_heap() {
     cout << "Done" << endl;
 }
 
+/////////////////////////////////Calendar/////////////////////////////////////////
+// The start windows of a task are kept as sorted, disjoint intervals of start times, so that
+// earliest_given_constraint is a binary search. With busy time, a task of duration d cannot
+// start in (b0 - d, b1) for a busy interval [b0, b1); the starts left replace the windows of
+// the task. Windows are also capped at deadline - d, so that a start moved into a window
+// cannot miss the deadline. A task that fits nowhere gets kNoStart.
+
+const pair<int, int> kNoStart(0, -1);
+
+// Sorted and merged, without empty intervals.
+vector<pair<int, int> > merge_intervals(vector<pair<int, int> > intervals) {
+    sort(intervals.begin(), intervals.end());
+    vector<pair<int, int> > merged;
+    for (const auto& interval : intervals) {
+        if (interval.second < interval.first) continue;
+        if (!merged.empty() && interval.first <= merged.back().second) {
+            merged.back().second = max(merged.back().second, interval.second);
+        } else {
+            merged.push_back(interval);
+        }
+    }
+    return merged;
+}
+
+// Starts of a task of the given duration that do not overlap the (merged) busy intervals.
+vector<pair<int, int> > get_free_starts(const vector<pair<int, int> >& busy, int duration) {
+    vector<pair<int, int> > free_starts;
+    int lo = 0;
+    for (const auto& b : busy) {
+        if (lo <= b.first - duration) free_starts.push_back(make_pair(lo, b.first - duration));
+        lo = max(lo, b.second);
+    }
+    free_starts.push_back(make_pair(lo, numeric_limits<int>::max()));
+    return free_starts;
+}
+
+void build_calendar(Tasks* tasks) {
+    // Busy intervals are half open, so touching ones merge as well.
+    vector<pair<int, int> > busy;
+    sort(tasks->busy_intervals.begin(), tasks->busy_intervals.end());
+    for (const auto& b : tasks->busy_intervals) {
+        if (b.second <= b.first) continue;
+        if (!busy.empty() && b.first <= busy.back().second) busy.back().second = max(busy.back().second, b.second);
+        else busy.push_back(b);
+    }
+    tasks->busy_intervals = busy;
+
+    for (Task& task : tasks->tasks) {
+        TimeSegment& time = task.time;
+        const bool constrained = !time.start_time_intervals.empty();
+        vector<pair<int, int> > windows = merge_intervals(time.start_time_intervals);
+        if (constrained && windows.empty()) windows.push_back(kNoStart);
+
+        // Without windows or busy time the deadline is checked by earliest_given_constraint.
+        if (constrained || !busy.empty()) {
+            if (!constrained) windows.push_back(make_pair(0, numeric_limits<int>::max()));
+            const vector<pair<int, int> > free_starts = get_free_starts(busy, time.duration);
+            const int latest = time.deadline > 0 ? time.deadline - time.duration : numeric_limits<int>::max();
+
+            // Intersect both sorted lists.
+            vector<pair<int, int> > starts;
+            for (int i = 0, j = 0; i < windows.size() && j < free_starts.size(); ) {
+                const int lo = max(windows[i].first, free_starts[j].first);
+                const int hi = min(min(windows[i].second, free_starts[j].second), latest);
+                if (lo <= hi) starts.push_back(make_pair(lo, hi));
+                if (windows[i].second < free_starts[j].second) i++;
+                else j++;
+            }
+            if (starts.empty()) starts.push_back(kNoStart);
+            windows = starts;
+        }
+        time.start_time_intervals = windows;
+    }
+}
+
 // Compact representation of schedule internal status.
-struct ScheduleItem {
+// Stamp is the type of the per-task end times: time_t, or int16_t when the tasks
+// are expressed in ticks (see Compact nodes).
+template <typename Stamp>
+struct ScheduleItemT {
     int num_scheduled = 0;
-    vector<time_t> end_timestamps;
+    vector<Stamp> end_timestamps;
     // The most recent ending timestamp.
     time_t end_timestamp = -1;
     int slot_index = -1;
+    // Partial expansion: set once the node has been expanded and re-queued
+    // with the value of its next-best unqueued child.
+    bool expanded = false;
 
     // Specify the number of tasks beforehand.
     // If a task is not scheduled, its end_timestamp is -1
-    ScheduleItem() {
+    ScheduleItemT() {
     }
 
-    ScheduleItem(int N) : end_timestamps(N, -1) {
+    ScheduleItemT(int N) : end_timestamps(N, -1) {
     }
 
-    ScheduleItem next(int new_task, time_t end_timestamp) const {
-        ScheduleItem new_item = *this;
+    ScheduleItemT next(int new_task, time_t end_timestamp) const {
+        ScheduleItemT new_item = *this;
         new_item.num_scheduled++;
-        new_item.end_timestamps[new_task] = end_timestamp;
+        new_item.end_timestamps[new_task] = (Stamp)end_timestamp;
         new_item.end_timestamp = max(new_item.end_timestamp, end_timestamp);
+        new_item.expanded = false;
 
         return new_item;
     }
 
+    // Temporarily place new_task in this item (used to score a child without copying it).
+    // Returns the previous end_timestamp so that Undo() can restore the item.
+    time_t Do(int new_task, time_t end_timestamp) {
+        time_t prev_end_timestamp = this->end_timestamp;
+        num_scheduled++;
+        end_timestamps[new_task] = (Stamp)end_timestamp;
+        this->end_timestamp = max(this->end_timestamp, end_timestamp);
+        return prev_end_timestamp;
+    }
+
+    void Undo(int new_task, time_t prev_end_timestamp) {
+        num_scheduled--;
+        end_timestamps[new_task] = -1;
+        end_timestamp = prev_end_timestamp;
+    }
+
+    // Fixed size binary form, used to spill the node to disk.
+    static int GetRecordSize(int N) {
+        return sizeof(int) + sizeof(time_t) + 1 + N * sizeof(Stamp);
+    }
+
+    void Save(char* record) const {
+        memcpy(record, &num_scheduled, sizeof(int));
+        memcpy(record + sizeof(int), &end_timestamp, sizeof(time_t));
+        record[sizeof(int) + sizeof(time_t)] = expanded;
+        memcpy(record + sizeof(int) + sizeof(time_t) + 1, end_timestamps.data(), end_timestamps.size() * sizeof(Stamp));
+    }
+
+    void Load(const char* record) {
+        memcpy(&num_scheduled, record, sizeof(int));
+        memcpy(&end_timestamp, record + sizeof(int), sizeof(time_t));
+        expanded = record[sizeof(int) + sizeof(time_t)] != 0;
+        memcpy(end_timestamps.data(), record + sizeof(int) + sizeof(time_t) + 1, end_timestamps.size() * sizeof(Stamp));
+    }
+
     vector<int> GetOrder() const {
         vector<pair<time_t, int>> sort_pairs;
         for (int i = 0; i < end_timestamps.size(); ++i) {
-            if (end_timestamps[i] > 0) {
+            if (end_timestamps[i] >= 0) {
                 sort_pairs.emplace_back(make_pair(end_timestamps[i], i));
             }
         }
@@ -269,21 +394,39 @@ struct ScheduleItem {
         }
     }
 
-    friend bool operator<(const ScheduleItem& s1, const ScheduleItem& s2) {
+    friend bool operator<(const ScheduleItemT& s1, const ScheduleItemT& s2) {
         // Note since the priority queue in c++ always returns the greatest element, 
         // we reverse the definition of <.
         return s1.end_timestamp > s2.end_timestamp;
     }
 };
 
+typedef ScheduleItemT<time_t> ScheduleItem;
 typedef pair<float, ScheduleItem> SchedulePair;
 
-time_t earliest_given_pre_req(time_t global_start_time, const Tasks& tasks, int curr_task_idx, const ScheduleItem& completed) {
+// A scored child of the node under expansion, kept small so that a node can be
+// re-expanded without copying all of its children.
+struct ChildEntry {
+    float score;
+    int task;
+    time_t end_time;
+
+    ChildEntry(float s, int t, time_t e) : score(s), task(t), end_time(e) {
+    }
+
+    friend bool operator<(const ChildEntry& c1, const ChildEntry& c2) {
+        if (c1.score != c2.score) return c1.score < c2.score;
+        return c1.task < c2.task;
+    }
+};
+
+template <typename Stamp>
+time_t earliest_given_pre_req(time_t global_start_time, const Tasks& tasks, int curr_task_idx, const ScheduleItemT<Stamp>& completed) {
     // Find the earliest starting time.
     time_t start_time = completed.num_scheduled > 0 ? completed.end_timestamp : global_start_time;
     for (const int& pre_index : tasks.tasks[curr_task_idx].pre_req_indices) {
         if (completed.end_timestamps[pre_index] < 0) return -1;
-        start_time = max(start_time, completed.end_timestamps[pre_index] + tasks.tasks[pre_index].time.cool_down);
+        start_time = max(start_time, (time_t)completed.end_timestamps[pre_index] + tasks.tasks[pre_index].time.cool_down);
     }
     return start_time;
 }
@@ -297,21 +440,23 @@ time_t earliest_given_constraint(const Task& task, time_t start_time) {
 
     if (time.start_time_intervals.empty()) return start_time;
 
-    bool fit_in = false;
-    for (int i = 0; i < time.start_time_intervals.size(); ++i) {
-        // If the start_time is earlier than then the latest starting time, we could schedule.
-        if (start_time <= time.start_time_intervals[i].second) {
-            start_time = max(start_time, (time_t)time.start_time_intervals[i].first);
-            fit_in = true;
-            break;
-        }
-    }
-
-    if (fit_in) return start_time;
-    else return -1;
+    // The first window whose latest starting time is not before start_time (see Calendar).
+    auto it = lower_bound(time.start_time_intervals.begin(), time.start_time_intervals.end(), start_time,
+                          [](const pair<int, int>& interval, time_t t) { return interval.second < t; });
+    if (it == time.start_time_intervals.end()) return -1;
+    return max(start_time, (time_t)it->first);
 }
 
-bool get_lb(const Tasks& tasks, const ScheduleItem& completed, float* score) {
+// ready is all zeros and starts is scratch space, both of size N.
+template <typename Stamp>
+bool get_lb(const Tasks& tasks, const TaskKernelData& kernel_data, const ScheduleItemT<Stamp>& completed,
+            const vector<int>& ready, vector<int>* starts, float* score) {
+    // Whether each task could still start after the current end.
+    get_earliest_starts(kernel_data, ready.data(), completed.end_timestamp, 0, starts->data());
+    for (int i : kernel_data.multi_window) {
+        if ((*starts)[i] >= 0) (*starts)[i] = earliest_given_constraint(tasks.tasks[i], completed.end_timestamp);
+    }
+
     // Compute the heuristic function.
     time_t lower_bound = 0;
     for (int i = 0; i < tasks.tasks.size(); ++i) {
@@ -321,9 +466,8 @@ bool get_lb(const Tasks& tasks, const ScheduleItem& completed, float* score) {
         // The task is notyet added.
         const Task& task = tasks.tasks[i];
 
-        time_t opt_start_time = earliest_given_constraint(task, completed.end_timestamp);
         // You can never start this job, set the score to be very low.
-        if (opt_start_time < 0) {
+        if ((*starts)[i] < 0) {
             // Penalty for not achieving the goal.
             lower_bound += task.time.duration * task.time.priority;
         } else {
@@ -335,35 +479,340 @@ bool get_lb(const Tasks& tasks, const ScheduleItem& completed, float* score) {
     return true;
 }
 
-// Input a few tasks and return a complete schedule.
-bool make_schedule(const Tasks& tasks, Schedules* schedules) {
+/////////////////////////////////Portfolio////////////////////////////////////////
+// Shared by all engines working on the same tasks. Each engine publishes improvements of its
+// best schedule into the incumbent and prunes with the best complete one. Engines return
+// their best schedule so far as soon as stop is set, either because one of them proved
+// optimality or because the time budget expired.
+struct SearchControl {
+    atomic<bool> stop;
+    // Best schedule found by any engine so far, see get_key.
+    atomic<long long> incumbent;
+    bool has_deadline;
+    chrono::steady_clock::time_point deadline;
+    // The tasks are in ticks (see Compact nodes) and A* keeps 16-bit end times.
+    bool compact_nodes;
+
+    SearchControl(const Tasks& tasks) : stop(false), incumbent(numeric_limits<long long>::max()), has_deadline(tasks.time_budget_ms > 0), compact_nodes(false) {
+        if (has_deadline) deadline = chrono::steady_clock::now() + chrono::milliseconds(tasks.time_budget_ms);
+    }
+
+    // More scheduled tasks first, then the earliest end. Smaller is better.
+    static long long get_key(int num_missing, time_t end_timestamp) {
+        return ((long long)num_missing << 32) + end_timestamp;
+    }
+
+    void publish(int num_missing, time_t end_timestamp) {
+        const long long key = get_key(num_missing, end_timestamp);
+        long long curr = incumbent.load();
+        while (key < curr && !incumbent.compare_exchange_weak(curr, key)) { }
+    }
+
+    // End of the best complete schedule so far, if any.
+    time_t get_complete_bound() const {
+        const long long key = incumbent.load(memory_order_relaxed);
+        return key < (1ll << 32) ? key : numeric_limits<time_t>::max();
+    }
+
+    bool should_stop() {
+        if (stop.load(memory_order_relaxed)) return true;
+        if (has_deadline && chrono::steady_clock::now() >= deadline) {
+            stop = true;
+            return true;
+        }
+        return false;
+    }
+};
+
+string get_engine_name(Tasks::Engine engine) {
+    switch (engine) {
+        case Tasks::ASTAR: return "astar";
+        case Tasks::DP: return "dp";
+        case Tasks::PORTFOLIO: return "portfolio";
+        case Tasks::LNS: return "lns";
+    }
+    return "";
+}
+
+// Convert the best (possibly partial) schedule into the output format.
+template <typename Stamp>
+void fill_schedules(const Tasks& tasks, const ScheduleItemT<Stamp>& best_schedule, int num_steps, Schedules* schedules) {
+    const int N = tasks.tasks.size();
+
+    // Get the best schedule.
+    vector<int> order = best_schedule.GetOrder();
+
+    if (order.size() < N) {
+        schedules->status = Schedules::FinalStatus::INCOMPLETE;
+        for (int i = 0; i < N; ++i) {
+              // Save incompleted tasks.
+              if (best_schedule.end_timestamps[i] < 0) {
+                  schedules->incomplete_tasks.push_back(i);
+              }
+        }
+    } else {
+        schedules->status = Schedules::FinalStatus::SUCCESS;
+    }
+    schedules->search_steps = num_steps;
+    schedules->total_duration = best_schedule.end_timestamp - tasks.global_start_time;
+
+    // From the order, construct the best schedule and get their start/end timestamp.
+    schedules->schedules.clear();
+    int duration = 0;
+    for (int i = 0; i < order.size(); ++i) {
+        Schedule s;
+
+        const int task_index = order[i];
+        const Task& task = tasks.tasks[task_index];
+
+        s.idx = task.idx;
+        s.end = best_schedule.end_timestamps[task_index];        
+        s.start = s.end - task.time.duration;
+        // Add the schedule into the scheduler.
+        schedules->schedules.push_back(s);
+
+        duration += task.time.duration;
+    }
+
+    schedules->used_duration = duration;
+}
+
+/////////////////////////////////Spill///////////////////////////////////////////
+// Overflow of the A* open list. Instead of dropping the worst nodes, A* writes them as fixed
+// size records into an unlinked temporary file that is mapped into memory. Records are
+// collected in a buffer, sorted by score and appended to the file as a run; the runs are
+// merged back in score order once the queue in memory no longer holds the best node.
+class SpillStore {
+private:
+    int m_fd = -1;
+    char* m_data = nullptr;
+    size_t m_capacity = 0, m_size = 0;
+    // Each record is the score followed by record_size bytes.
+    int m_record_size = 0;
+    int m_num_records = 0;
+
+    // Records not yet written to the file.
+    vector<char> m_buffer;
+    vector<pair<float, int> > m_buffer_scores;
+    float m_buffer_min = numeric_limits<float>::max();
+
+    // Runs by the score of their next record, with their next and end offsets.
+    struct Run {
+        size_t next, end;
+    };
+    vector<Run> m_runs;
+    priority_queue<pair<float, int>, vector<pair<float, int> >, greater<pair<float, int> > > m_heads;
+
+    long long m_bytes_written = 0, m_bytes_read = 0;
+
+    size_t stride() const { return sizeof(float) + m_record_size; }
+
+    bool Reserve(size_t size) {
+        if (size <= m_capacity) return true;
+        size_t capacity = max(size, 2 * m_capacity);
+        if (ftruncate(m_fd, capacity) != 0) return false;
+        // The old mapping stays until the new one exists, so that a failure keeps the runs readable.
+        void* data = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+        if (data == MAP_FAILED) return false;
+        if (m_data != nullptr) munmap(m_data, m_capacity);
+        m_data = (char*)data;
+        m_capacity = capacity;
+        return true;
+    }
+
+    void ClearBuffer() {
+        m_buffer.clear();
+        m_buffer_scores.clear();
+        m_buffer_min = numeric_limits<float>::max();
+    }
+
+    // Write the buffer as a new run. If the file cannot grow, the buffered records are dropped
+    // and false is returned; the runs already written stay readable.
+    bool Flush() {
+        if (m_buffer_scores.empty()) return true;
+        // Space of runs that were read completely is reused once all of them are.
+        if (m_heads.empty()) {
+            m_size = 0;
+            m_runs.clear();
+        }
+        const size_t begin = m_size;
+        const size_t bytes = m_buffer_scores.size() * stride();
+        if (!Reserve(begin + bytes)) {
+            m_num_records -= m_buffer_scores.size();
+            ClearBuffer();
+            return false;
+        }
+        sort(m_buffer_scores.begin(), m_buffer_scores.end());
+        char* p = m_data + begin;
+        for (const auto& entry : m_buffer_scores) {
+            memcpy(p, &entry.first, sizeof(float));
+            memcpy(p + sizeof(float), &m_buffer[(size_t)entry.second * m_record_size], m_record_size);
+            p += stride();
+        }
+        m_size += bytes;
+        m_bytes_written += bytes;
+        m_runs.push_back(Run{begin, begin + bytes});
+        m_heads.push(make_pair(m_buffer_scores.front().first, (int)m_runs.size() - 1));
+        ClearBuffer();
+        return true;
+    }
+
+public:
+    static const int kRunSize = 4096;
+
+    ~SpillStore() {
+        if (m_data != nullptr) munmap(m_data, m_capacity);
+        if (m_fd >= 0) close(m_fd);
+    }
+
+    bool Open(int record_size) {
+        const char* dir = getenv("TMPDIR");
+        string path = string(dir != nullptr ? dir : "/tmp") + "/schedule_spill_XXXXXX";
+        vector<char> name(path.begin(), path.end());
+        name.push_back('\0');
+        m_fd = mkstemp(name.data());
+        if (m_fd < 0) return false;
+        // The file goes away with the descriptor.
+        unlink(name.data());
+        m_record_size = record_size;
+        return true;
+    }
+
+    bool IsOpen() const { return m_fd >= 0; }
+    bool IsEmpty() const { return m_num_records == 0; }
+    int GetSize() const { return m_num_records; }
+    long long GetBytesWritten() const { return m_bytes_written; }
+    long long GetBytesRead() const { return m_bytes_read; }
+
+    // Returns false if records had to be dropped, see Flush.
+    bool Add(float score, const char* record) {
+        m_buffer_scores.push_back(make_pair(score, (int)m_buffer_scores.size()));
+        m_buffer.insert(m_buffer.end(), record, record + m_record_size);
+        m_buffer_min = min(m_buffer_min, score);
+        m_num_records++;
+        if (m_buffer_scores.size() >= kRunSize) return Flush();
+        return true;
+    }
+
+    float GetMinScore() const {
+        return m_heads.empty() ? m_buffer_min : min(m_buffer_min, m_heads.top().first);
+    }
+
+    // Remove the record with the smallest score. Returns false if the buffered records had to
+    // be dropped instead, see Flush.
+    bool PopMin(float* score, char* record) {
+        if (!Flush()) return false;
+        const int r = m_heads.top().second;
+        m_heads.pop();
+        Run& run = m_runs[r];
+        memcpy(score, m_data + run.next, sizeof(float));
+        memcpy(record, m_data + run.next + sizeof(float), m_record_size);
+        run.next += stride();
+        m_bytes_read += stride();
+        m_num_records--;
+        if (run.next < run.end) {
+            float next_score;
+            memcpy(&next_score, m_data + run.next, sizeof(float));
+            m_heads.push(make_pair(next_score, r));
+        }
+        return true;
+    }
+};
+
+// Best-first search over partial schedules.
+template <typename Stamp>
+bool search_astar(const Tasks& tasks, SearchControl* control, Schedules* schedules) {
+    typedef ScheduleItemT<Stamp> ScheduleItem;
+
     // test_heap();
     const int N = tasks.tasks.size();
     // cout << "#Task = " << N << endl;
 
-    vector<int> back_container(tasks.max_heap_size + N, -1);
-    set<int> unused_slot;
-    for (int i = 0; i < tasks.max_heap_size + N; ++i) {
-        unused_slot.insert(i);
+    // The search is complete (and the first complete schedule optimal) unless nodes were evicted.
+    bool evicted = false;
+
+    // Nodes over max_heap_size go to disk instead of being dropped, and come back in batches.
+    SpillStore spill;
+    const int page_in_size = 256;
+    vector<char> record(ScheduleItem::GetRecordSize(N));
+    if (tasks.spill_open_list && !spill.Open(record.size())) {
+        cout << "Spill: cannot create a temporary file, dropping nodes instead" << endl;
     }
+    const int num_slots = tasks.max_heap_size + N + (spill.IsOpen() ? page_in_size : 0);
+    // Once the file cannot grow, nodes are dropped again; the ones on disk are still read back.
+    bool spilling = spill.IsOpen();
+    auto stop_spilling = [&]() {
+        cout << "Spill: cannot grow the file, dropping nodes instead" << endl;
+        spilling = false;
+        evicted = true;
+    };
+
+    vector<int> back_container(num_slots, -1);
+    // The smallest unused slot is taken first. Slots from num_used_slots on were never used, so
+    // only the released ones are kept, and the setup does not grow with max_heap_size.
+    priority_queue<int, vector<int>, greater<int> > unused_slot;
+    int num_used_slots = 0;
+    auto take_slot = [&]() -> int {
+        if (unused_slot.empty()) return num_used_slots++;
+        const int slot_index = unused_slot.top();
+        unused_slot.pop();
+        return slot_index;
+    };
 
     ScheduleItem best_schedule(N);
     float best_score;
+    bool proven = false;
 
     int num_steps = 0;
     Heap<float, ScheduleItem> q;
     Heap<float, int> back_q;
 
     ScheduleItem completed(N);
-    completed.slot_index = 0;
-    q.Insert(0.0, completed, &back_container[0]);    
-    back_q.Insert(0.0, 0, nullptr);
-    unused_slot.erase(0);
+    completed.slot_index = take_slot();
+    q.Insert(0.0, completed, &back_container[completed.slot_index]);    
+    back_q.Insert(0.0, completed.slot_index, nullptr);
+
+    auto push = [&](float next_score, ScheduleItem& next_item) {
+        int slot_index = take_slot();
+        next_item.slot_index = slot_index;
+        q.Insert(next_score, next_item, &back_container[slot_index]);
+        back_q.Insert(-next_score, slot_index, nullptr);
+    };
+
+    vector<ChildEntry> children;
+    children.reserve(N);
+
+    // Start times of all tasks at once, see schedule_kernel.h.
+    const TaskKernelData kernel_data(tasks);
+    vector<int> ready(N), starts(N), lb_ready(N, 0), lb_starts(N);
 
     float score;
-    while (!q.IsEmpty()) {
+    while (!q.IsEmpty() || !spill.IsEmpty()) {
+        if (control->should_stop()) break;
+
+        if (!spill.IsEmpty() && (q.IsEmpty() || spill.GetMinScore() < q.GetKey(1))) {
+            ScheduleItem item(N);
+            for (int k = 0; k < page_in_size && !spill.IsEmpty(); ++k) {
+                float spilled_score;
+                if (!spill.PopMin(&spilled_score, record.data())) {
+                    stop_spilling();
+                    continue;
+                }
+                item.Load(record.data());
+                push(spilled_score, item);
+            }
+            if (q.IsEmpty()) continue;
+        }
+
         q.DeleteMin(&score, &completed);
-        unused_slot.insert(completed.slot_index);
+        unused_slot.push(completed.slot_index);
+
+        // Every node left is bounded by the best complete schedule of another engine.
+        const time_t bound = control->get_complete_bound();
+        if (score >= bound) {
+            proven = !evicted;
+            break;
+        }
 
 		/*
         cout << score << endl;
@@ -377,9 +826,11 @@ bool make_schedule(const Tasks& tasks, Schedules* schedules) {
         // q.pop();
         num_steps++;
 
-        if (completed.num_scheduled > best_schedule.num_scheduled) {
+        if (completed.num_scheduled > best_schedule.num_scheduled ||
+            (completed.num_scheduled == best_schedule.num_scheduled && completed.end_timestamp < best_schedule.end_timestamp)) {
             best_schedule = completed;
             best_score = score;
+            control->publish(N - best_schedule.num_scheduled, best_schedule.end_timestamp);
 
 			/*
 			cout << score << endl;
@@ -388,31 +839,56 @@ bool make_schedule(const Tasks& tasks, Schedules* schedules) {
 			*/
         }
 
-        if (best_schedule.num_scheduled == N) break;
+        if (best_schedule.num_scheduled == N) {
+            proven = !evicted;
+            break;
+        }
 
-        // Make 
+        // Earliest start of each task scheduled next, -1 if it is already scheduled,
+        // waits for a pre-req or does not fit.
         for (int i = 0; i < N; ++i) {
-			// If the event is already scheduled, go to the next one. 
-            if (completed.end_timestamps[i] >= 0) continue;
-
-            // Else try scheduling it.
-            time_t start_time = earliest_given_pre_req(tasks.global_start_time, tasks, i, completed);
-
-            if (start_time < 0) continue;
-            start_time = earliest_given_constraint(tasks.tasks[i], start_time + tasks.rest_time);
+            ready[i] = completed.end_timestamps[i] >= 0 ? -1 : earliest_given_pre_req(tasks.global_start_time, tasks, i, completed);
+        }
+        const time_t base = completed.num_scheduled > 0 ? completed.end_timestamp : tasks.global_start_time;
+        get_earliest_starts(kernel_data, ready.data(), base, tasks.rest_time, starts.data());
+        for (int i : kernel_data.multi_window) {
+            if (starts[i] >= 0) starts[i] = earliest_given_constraint(tasks.tasks[i], max(base, (time_t)ready[i]) + tasks.rest_time);
+        }
 
-            if (start_time < 0) continue;
-            time_t end_time = start_time + tasks.tasks[i].time.duration;
+        // Score all children without materializing them.
+        children.clear();
+        for (int i = 0; i < N; ++i) {
+            if (starts[i] < 0) continue;
+            time_t end_time = starts[i] + tasks.tasks[i].time.duration;
 
-            ScheduleItem next_item = completed.next(i, end_time);
+            time_t prev_end_timestamp = completed.Do(i, end_time);
             float next_score;
-            if (get_lb(tasks, next_item, &next_score)) {
-                int slot_index = *unused_slot.begin();
-                next_item.slot_index = slot_index;
-                q.Insert(next_score, next_item, &back_container[slot_index]);
-                back_q.Insert(-next_score, slot_index, nullptr);
-                unused_slot.erase(slot_index);
-            }
+            bool valid = get_lb(tasks, kernel_data, completed, lb_ready, &lb_starts, &next_score);
+            completed.Undo(i, prev_end_timestamp);
+            if (valid) children.push_back(ChildEntry(next_score, i, end_time));
+        }
+        sort(children.begin(), children.end());
+        while (!children.empty() && children.back().score >= bound) children.pop_back();
+
+        // Partial expansion: only queue the children whose f-value is covered by the
+        // stored value of the parent. On the first expansion this also includes the
+        // children below it (the heuristic is not consistent); on a re-expansion those
+        // were queued already and the stored value is exactly the next child value.
+        // The parent goes back with the value of its next-best child.
+        int first_child = 0;
+        if (completed.expanded) {
+            while (first_child < children.size() && children[first_child].score < score) first_child++;
+        }
+        int last_child = tasks.partial_expansion ? first_child : children.size();
+        while (last_child < children.size() && children[last_child].score <= score) last_child++;
+
+        for (int k = first_child; k < last_child; ++k) {
+            ScheduleItem next_item = completed.next(children[k].task, children[k].end_time);
+            push(children[k].score, next_item);
+        }
+        if (last_child < children.size()) {
+            completed.expanded = true;
+            push(children[last_child].score, completed);
         }
 
         // If queue is too large, remove the worst one.
@@ -422,52 +898,1022 @@ bool make_schedule(const Tasks& tasks, Schedules* schedules) {
                 back_q.DeleteMin(nullptr, &slot_index);
                 int heap_index = back_container[slot_index];
                 if (heap_index >= 0) {
+                    if (spilling) {
+                        q.GetContent(heap_index).Save(record.data());
+                        if (!spill.Add(q.GetKey(heap_index), record.data())) stop_spilling();
+                    } else {
+                        evicted = true;
+                    }
                     // Remove
                     q.Delete(heap_index);
-                    unused_slot.insert(slot_index);
+                    unused_slot.push(slot_index);
                     break;
                 }
             }
         }
     }
 
-	cout << "Search finished. #Step = " << num_steps << " Size of queue " << q.GetSize() << endl;
+    // Nothing left to explore.
+    if (q.IsEmpty() && spill.IsEmpty() && !evicted) proven = true;
 
-    // Get the best schedule.
-    vector<int> order = best_schedule.GetOrder();
+	cout << "Search finished. #Step = " << num_steps << " Size of queue " << q.GetSize();
+    if (spill.IsOpen()) cout << " Spilled " << spill.GetSize();
+    cout << endl;
 
-    if (order.size() < N) {
-        schedules->status = Schedules::FinalStatus::INCOMPLETE;
+    fill_schedules(tasks, best_schedule, num_steps, schedules);
+    schedules->engine = Tasks::ASTAR;
+    schedules->proven_optimal = proven;
+    schedules->spill_bytes_written = spill.GetBytesWritten();
+    schedules->spill_bytes_read = spill.GetBytesRead();
+    if (proven) control->stop = true;
+    return true;
+}
+
+bool make_schedule_astar(const Tasks& tasks, SearchControl* control, Schedules* schedules) {
+    if (control->compact_nodes) return search_astar<int16_t>(tasks, control, schedules);
+    return search_astar<time_t>(tasks, control, schedules);
+}
+
+/////////////////////////////////Subset DP////////////////////////////////////////
+// Exact solver for small task sets. A state is the set of scheduled tasks plus the time
+// the last one ends. Since a cool-down can delay a dependent task past that time, the state
+// also keeps the release time (end + cool_down) of every task that has both a cool-down and
+// dependents. For each subset only the Pareto front of (end, releases) is kept: the earliest
+// start of any task is monotone in these, so a dominated state can never lead to a better
+// schedule.
+//
+// Subsets are processed layer by layer (by the number of scheduled tasks). The states of a
+// layer are stored flat, grouped by subset, and front_begin/front_size (indexed by the subset
+// mask) locate the group of each subset in its layer.
+const int kMaxDPTasks = 20;
+
+struct DPLayer {
+    vector<int> ends;
+    // num_releases entries per state.
+    vector<int> releases;
+    // Index of the predecessor state in the previous layer.
+    vector<int> parents;
+    // Task appended to the predecessor.
+    vector<unsigned char> tasks;
+
+    int size() const { return ends.size(); }
+
+    void append(const DPLayer& other, int idx, int num_releases) {
+        ends.push_back(other.ends[idx]);
+        releases.insert(releases.end(), other.releases.begin() + idx * num_releases, other.releases.begin() + (idx + 1) * num_releases);
+        parents.push_back(other.parents[idx]);
+        tasks.push_back(other.tasks[idx]);
+    }
+
+    void append(const DPLayer& other) {
+        ends.insert(ends.end(), other.ends.begin(), other.ends.end());
+        releases.insert(releases.end(), other.releases.begin(), other.releases.end());
+        parents.insert(parents.end(), other.parents.begin(), other.parents.end());
+        tasks.insert(tasks.end(), other.tasks.begin(), other.tasks.end());
+    }
+
+    void clear() {
+        ends.clear();
+        releases.clear();
+        parents.clear();
+        tasks.clear();
+    }
+};
+
+struct DPSolver {
+    const Tasks& tasks;
+    SearchControl* control;
+    int N;
+    // Bitmask of the pre-reqs of each task.
+    vector<unsigned int> pre_masks;
+    // Slot in DPLayer::releases of each task (-1 if its release never matters).
+    vector<int> release_slots;
+    int num_releases;
+    // Sum of duration + rest_time over all tasks, to bound the end of a complete schedule.
+    int total_work;
+    bool aborted;
+
+    vector<unsigned int> front_begin;
+    vector<unsigned int> front_size;
+    vector<DPLayer> layers;
+
+    DPSolver(const Tasks& t, SearchControl* c) : tasks(t), control(c), N(t.tasks.size()), pre_masks(N, 0), release_slots(N, -1), num_releases(0), total_work(0), aborted(false) {
+        for (const Task& task : tasks.tasks) {
+            total_work += task.time.duration + tasks.rest_time;
+            for (int pre_index : task.pre_req_indices) {
+                pre_masks[task.idx] |= 1u << pre_index;
+                if (tasks.tasks[pre_index].time.cool_down > 0 && release_slots[pre_index] < 0) {
+                    release_slots[pre_index] = num_releases++;
+                }
+            }
+        }
+        front_begin.assign(1u << N, 0);
+        front_size.assign(1u << N, 0);
+    }
+
+    // Does state a (from cand) dominate state b? Only meaningful for states of the same subset.
+    bool dominates(const DPLayer& cand, int a, int b) const {
+        if (cand.ends[a] > cand.ends[b]) return false;
+        for (int k = 0; k < num_releases; ++k) {
+            int ra = max(cand.ends[a], cand.releases[a * num_releases + k]);
+            int rb = max(cand.ends[b], cand.releases[b * num_releases + k]);
+            if (ra > rb) return false;
+        }
+        return true;
+    }
+
+    // Build the front of every subset in [subsets, subsets + n) from the previous layer.
+    // front_begin of these subsets is relative to the start of out.
+    void expand(const DPLayer& prev, const unsigned int* subsets, int n, DPLayer* out, long long* num_states) {
+        DPLayer cand;
+        vector<int> order;
+        vector<int> kept;
+        for (int s = 0; s < n; ++s) {
+            if (s % 256 == 0 && control->should_stop()) return;
+
+            const unsigned int subset = subsets[s];
+            cand.clear();
+
+            // Candidates that cannot beat the best complete schedule are dropped.
+            int remaining_work = total_work;
+            for (int j = 0; j < N; ++j) {
+                if (subset & (1u << j)) remaining_work -= tasks.tasks[j].time.duration + tasks.rest_time;
+            }
+            const time_t bound = control->get_complete_bound() - remaining_work;
+            for (int j = 0; j < N; ++j) {
+                const unsigned int bit = 1u << j;
+                if ((subset & bit) == 0) continue;
+                const unsigned int pre_subset = subset ^ bit;
+                if ((pre_masks[j] & ~pre_subset) != 0) continue;
+
+                const Task& task = tasks.tasks[j];
+                const int begin = front_begin[pre_subset];
+                const int end = begin + front_size[pre_subset];
+                for (int p = begin; p < end; ++p) {
+                    // Same as earliest_given_pre_req: pre-reqs without cool-down end before the last task.
+                    time_t start_time = prev.ends[p];
+                    for (int pre_index : task.pre_req_indices) {
+                        int slot = release_slots[pre_index];
+                        if (slot >= 0) start_time = max(start_time, (time_t)prev.releases[p * num_releases + slot]);
+                    }
+                    start_time = earliest_given_constraint(task, start_time + tasks.rest_time);
+                    if (start_time < 0) continue;
+
+                    const int end_time = start_time + task.time.duration;
+                    if (end_time >= bound) continue;
+                    cand.ends.push_back(end_time);
+                    cand.releases.insert(cand.releases.end(), prev.releases.begin() + p * num_releases, prev.releases.begin() + (p + 1) * num_releases);
+                    if (release_slots[j] >= 0) cand.releases[cand.ends.size() * num_releases - num_releases + release_slots[j]] = end_time + task.time.cool_down;
+                    cand.parents.push_back(p);
+                    cand.tasks.push_back(j);
+                }
+            }
+            *num_states += cand.size();
+
+            // Keep the Pareto front, earliest end first.
+            order.resize(cand.size());
+            for (int i = 0; i < order.size(); ++i) order[i] = i;
+            sort(order.begin(), order.end(), [&](int a, int b) { return cand.ends[a] < cand.ends[b]; });
+            kept.clear();
+            for (int i : order) {
+                bool dominated = false;
+                for (int k : kept) {
+                    if (dominates(cand, k, i)) {
+                        dominated = true;
+                        break;
+                    }
+                }
+                if (!dominated) kept.push_back(i);
+                // Without releases the earliest end dominates everything else.
+                if (num_releases == 0) break;
+            }
+
+            front_begin[subset] = out->size();
+            front_size[subset] = kept.size();
+            for (int k : kept) out->append(cand, k, num_releases);
+        }
+    }
+
+    long long solve() {
+        long long num_states = 0;
+        layers.resize(N + 1);
+
+        // The empty schedule starts at global_start_time.
+        layers[0].ends.push_back(tasks.global_start_time);
+        layers[0].releases.assign(num_releases, 0);
+        layers[0].parents.push_back(-1);
+        layers[0].tasks.push_back(0);
+        front_begin[0] = 0;
+        front_size[0] = 1;
+
+        vector<unsigned int> subsets;
+        for (int k = 1; k <= N; ++k) {
+            // Enumerate all subsets with k tasks (Gosper's hack).
+            subsets.clear();
+            const unsigned long long limit = 1ull << N;
+            for (unsigned long long subset = (1ull << k) - 1; subset < limit; ) {
+                subsets.push_back(subset);
+                unsigned long long c = subset & -subset;
+                unsigned long long r = subset + c;
+                subset = (((r ^ subset) >> 2) / c) | r;
+            }
+
+            const int num_threads = min(max(tasks.num_threads, 1), (int)subsets.size() / 1024 + 1);
+            if (num_threads == 1) {
+                expand(layers[k - 1], subsets.data(), subsets.size(), &layers[k], &num_states);
+            } else {
+                vector<DPLayer> chunks(num_threads);
+                vector<long long> chunk_states(num_threads, 0);
+                vector<thread> workers;
+                const int chunk_size = (subsets.size() + num_threads - 1) / num_threads;
+                for (int t = 0; t < num_threads; ++t) {
+                    const int begin = min((int)subsets.size(), t * chunk_size);
+                    const int end = min((int)subsets.size(), begin + chunk_size);
+                    workers.push_back(thread([&, t, begin, end]() {
+                        expand(layers[k - 1], subsets.data() + begin, end - begin, &chunks[t], &chunk_states[t]);
+                    }));
+                }
+                for (auto& worker : workers) worker.join();
+
+                // Concatenate the chunks and rebase the fronts.
+                for (int t = 0; t < num_threads; ++t) {
+                    const int offset = layers[k].size();
+                    const int begin = min((int)subsets.size(), t * chunk_size);
+                    const int end = min((int)subsets.size(), begin + chunk_size);
+                    for (int s = begin; s < end; ++s) front_begin[subsets[s]] += offset;
+                    layers[k].append(chunks[t]);
+                    num_states += chunk_states[t];
+                }
+            }
+            if (control->stop) {
+                aborted = true;
+                break;
+            }
+            if (layers[k].size() == 0) break;
+        }
+        return num_states;
+    }
+
+    // Most tasks first, then the earliest end.
+    ScheduleItem get_best() const {
+        ScheduleItem best(N);
+        int k = N;
+        while (k > 0 && layers[k].size() == 0) k--;
+        if (k == 0) return best;
+
+        const DPLayer& last = layers[k];
+        int idx = min_element(last.ends.begin(), last.ends.end()) - last.ends.begin();
+        best.num_scheduled = k;
+        best.end_timestamp = last.ends[idx];
+        for (; k > 0; --k) {
+            best.end_timestamps[layers[k].tasks[idx]] = layers[k].ends[idx];
+            idx = layers[k].parents[idx];
+        }
+        return best;
+    }
+};
+
+bool make_schedule_dp(const Tasks& tasks, SearchControl* control, Schedules* schedules) {
+    DPSolver solver(tasks, control);
+    long long num_states = solver.solve();
+
+	cout << "DP finished. #States = " << num_states << endl;
+
+    ScheduleItem best_schedule = solver.get_best();
+    control->publish(tasks.tasks.size() - best_schedule.num_scheduled, best_schedule.end_timestamp);
+
+    fill_schedules(tasks, best_schedule, num_states, schedules);
+    schedules->engine = Tasks::DP;
+    schedules->proven_optimal = !solver.aborted;
+    if (schedules->proven_optimal) control->stop = true;
+    return true;
+}
+
+/////////////////////////////////Local search/////////////////////////////////////
+// Large-neighbourhood search for plans too large for best-first search. The solution is
+// an order of all tasks; walking it from global_start_time places every task as early as
+// possible, and a task that cannot be placed where it is stays incomplete. Each move
+// destroys a window of the order and repairs it with a small exact search (or relocates a
+// single task), then re-evaluates only as far as the change propagates: once the running
+// end time matches the old one and no changed task has a dependent further ahead, the rest
+// of the order is known to be unchanged. Moves that make the schedule worse are undone.
+const int kLNSWindow = 6;
+const int kLNSMaxShift = 64;
+// Without a time budget the stall limit alone can keep a large plan busy for minutes, since
+// every small improvement resets it.
+const int kLNSDefaultBudgetMs = 3000;
+
+struct LNSSolver {
+    const Tasks& tasks;
+    SearchControl* control;
+    int N;
+    vector<vector<int> > dependents;
+    // Latest time each task can start (max int if unconstrained).
+    vector<int> latest_start;
+
+    // Current solution.
+    vector<int> order;
+    // Position of each task in order.
+    vector<int> pos;
+    // End of each task (-1: incomplete).
+    vector<int> ends;
+    // End of the last placed task up to each position (global_start_time if none).
+    vector<int> prefix_ends;
+    int num_missing;
+
+    // Undo log of the current move.
+    int move_lo, move_hi;
+    vector<int> saved_order;
+    vector<int> saved_ends;
+    vector<pair<int, int> > ends_log;
+    vector<pair<int, int> > prefix_ends_log;
+    int saved_num_missing;
+
+    // Window repair.
+    vector<int> window;
+    vector<int> window_order, best_window_order;
+    int best_window_missing, best_window_end;
+
+    mt19937 rng;
+
+    LNSSolver(const Tasks& t, SearchControl* c) : tasks(t), control(c), N(t.tasks.size()), dependents(N), latest_start(N, numeric_limits<int>::max()),
+        order(N), pos(N), ends(N, -1), prefix_ends(N), num_missing(0), saved_ends(N, -1), rng(12345) {
+        for (const Task& task : tasks.tasks) {
+            for (int pre_index : task.pre_req_indices) dependents[pre_index].push_back(task.idx);
+
+            const TimeSegment& time = task.time;
+            if (!time.start_time_intervals.empty()) latest_start[task.idx] = time.start_time_intervals.back().second;
+            if (time.deadline > 0) latest_start[task.idx] = min(latest_start[task.idx], time.deadline - time.duration);
+        }
+    }
+
+    // End of task t placed at position p right after a task ending at prev_end, or -1 if it
+    // cannot be placed there. Same rules as earliest_given_pre_req, except that pre-reqs
+    // have to come earlier in the order.
+    int place(int t, int p, int prev_end) const {
+        const Task& task = tasks.tasks[t];
+        time_t start_time = prev_end;
+        for (int pre_index : task.pre_req_indices) {
+            if (pos[pre_index] >= p || ends[pre_index] < 0) return -1;
+            start_time = max(start_time, (time_t)ends[pre_index] + tasks.tasks[pre_index].time.cool_down);
+        }
+        start_time = earliest_given_constraint(task, start_time + tasks.rest_time);
+        return start_time < 0 ? -1 : start_time + task.time.duration;
+    }
+
+    int get_prev_end(int p) const {
+        return p > 0 ? prefix_ends[p - 1] : tasks.global_start_time;
+    }
+
+    int get_makespan() const {
+        return N > 0 ? prefix_ends[N - 1] : tasks.global_start_time;
+    }
+
+    // Topological order, most urgent task first.
+    void init() {
+        vector<int> num_pre_reqs(N, 0);
+        for (const Task& task : tasks.tasks) num_pre_reqs[task.idx] = task.pre_req_indices.size();
+
+        priority_queue<pair<int, int>, vector<pair<int, int> >, greater<pair<int, int> > > ready;
         for (int i = 0; i < N; ++i) {
-              // Save incompleted tasks.
-              if (best_schedule.end_timestamps[i] < 0) {
-                  schedules->incomplete_tasks.push_back(i);
-              }
+            if (num_pre_reqs[i] == 0) ready.push(make_pair(latest_start[i], i));
+        }
+        vector<bool> added(N, false);
+        order.clear();
+        while (!ready.empty()) {
+            int t = ready.top().second;
+            ready.pop();
+            order.push_back(t);
+            added[t] = true;
+            for (int dep : dependents[t]) {
+                if (--num_pre_reqs[dep] == 0) ready.push(make_pair(latest_start[dep], dep));
+            }
+        }
+        // Tasks in a dependency cycle can never be scheduled.
+        for (int i = 0; i < N; ++i) {
+            if (!added[i]) order.push_back(i);
+        }
+
+        int prev_end = tasks.global_start_time;
+        num_missing = 0;
+        for (int p = 0; p < N; ++p) pos[order[p]] = p;
+        for (int p = 0; p < N; ++p) {
+            const int t = order[p];
+            ends[t] = place(t, p, prev_end);
+            if (ends[t] < 0) num_missing++;
+            else prev_end = ends[t];
+            prefix_ends[p] = prev_end;
         }
-    } else {
-        schedules->status = Schedules::FinalStatus::SUCCESS;
     }
-    schedules->search_steps = num_steps;
-    schedules->total_duration = best_schedule.end_timestamp - tasks.global_start_time;
 
-    // From the order, construct the best schedule and get their start/end timestamp.
+    // Start a move that reorders [lo, hi).
+    void begin_move(int lo, int hi) {
+        move_lo = lo;
+        move_hi = hi;
+        saved_order.assign(order.begin() + lo, order.begin() + hi);
+        for (int p = lo; p < hi; ++p) saved_ends[order[p]] = ends[order[p]];
+        ends_log.clear();
+        prefix_ends_log.clear();
+        saved_num_missing = num_missing;
+    }
+
+    // Re-evaluate the order from move_lo until the change stops propagating.
+    void evaluate() {
+        int prev_end = get_prev_end(move_lo);
+        int old_prev_end = prev_end;
+        // Furthest position of a dependent of a task whose end changed.
+        int horizon = -1;
+        for (int p = move_lo; p < N; ++p) {
+            if (p >= move_hi && p > horizon && prev_end == old_prev_end) {
+                // In sync with the old solution from here on.
+                break;
+            }
+            const int t = order[p];
+            const int old_end = p < move_hi ? saved_ends[t] : ends[t];
+            const int new_end = place(t, p, prev_end);
+            if (p >= move_hi) ends_log.push_back(make_pair(t, old_end));
+            ends[t] = new_end;
+            if (new_end != old_end) {
+                num_missing += (new_end < 0) - (old_end < 0);
+                for (int dep : dependents[t]) horizon = max(horizon, pos[dep]);
+            }
+            if (new_end >= 0) prev_end = new_end;
+
+            old_prev_end = prefix_ends[p];
+            prefix_ends_log.push_back(make_pair(p, prefix_ends[p]));
+            prefix_ends[p] = prev_end;
+        }
+    }
+
+    void undo_move() {
+        for (auto it = prefix_ends_log.rbegin(); it != prefix_ends_log.rend(); ++it) prefix_ends[it->first] = it->second;
+        for (auto it = ends_log.rbegin(); it != ends_log.rend(); ++it) ends[it->first] = it->second;
+        for (int p = move_lo; p < move_hi; ++p) {
+            order[p] = saved_order[p - move_lo];
+            pos[order[p]] = p;
+            ends[order[p]] = saved_ends[order[p]];
+        }
+        num_missing = saved_num_missing;
+    }
+
+    // Exact search over the orders of the window tasks, minimizing (#incomplete, end).
+    void search_window(int p, int prev_end, int num_missing_so_far, int remaining_work) {
+        const int depth = window_order.size();
+        if (num_missing_so_far > best_window_missing) return;
+        if (num_missing_so_far == best_window_missing && prev_end + remaining_work >= best_window_end) return;
+        if (depth == window.size()) {
+            best_window_missing = num_missing_so_far;
+            best_window_end = prev_end;
+            best_window_order = window_order;
+            return;
+        }
+        for (int i = 0; i < window.size(); ++i) {
+            const int t = window[i];
+            if (pos[t] != numeric_limits<int>::max()) continue;
+            const int work = tasks.tasks[t].time.duration + tasks.rest_time;
+            pos[t] = p;
+            ends[t] = place(t, p, prev_end);
+            window_order.push_back(t);
+            if (ends[t] < 0) search_window(p + 1, prev_end, num_missing_so_far + 1, remaining_work - work);
+            else search_window(p + 1, ends[t], num_missing_so_far, remaining_work - work);
+            window_order.pop_back();
+            pos[t] = numeric_limits<int>::max();
+        }
+    }
+
+    void repair_window(int lo, int hi) {
+        begin_move(lo, hi);
+        window.assign(order.begin() + lo, order.begin() + hi);
+        int remaining_work = 0;
+        for (int t : window) {
+            pos[t] = numeric_limits<int>::max();
+            remaining_work += tasks.tasks[t].time.duration + tasks.rest_time;
+        }
+
+        best_window_missing = numeric_limits<int>::max();
+        best_window_end = numeric_limits<int>::max();
+        window_order.clear();
+        search_window(lo, get_prev_end(lo), 0, remaining_work);
+
+        for (int p = lo; p < hi; ++p) {
+            order[p] = best_window_order[p - lo];
+            pos[order[p]] = p;
+        }
+    }
+
+    // Move the task at position from to position to, shifting the ones in between.
+    void relocate(int from, int to) {
+        begin_move(min(from, to), max(from, to) + 1);
+        const int t = order[from];
+        if (from < to) {
+            for (int p = from; p < to; ++p) order[p] = order[p + 1];
+        } else {
+            for (int p = from; p > to; --p) order[p] = order[p - 1];
+        }
+        order[to] = t;
+        for (int p = move_lo; p < move_hi; ++p) pos[order[p]] = p;
+    }
+
+    long long solve() {
+        init();
+        control->publish(num_missing, get_makespan());
+        if (N < 2) return 0;
+
+        // Stop once no move has helped for a while, or at the default budget when none is given.
+        const long long max_stall = max(10000, 10 * N);
+        const chrono::steady_clock::time_point default_deadline =
+            chrono::steady_clock::now() + chrono::milliseconds(kLNSDefaultBudgetMs);
+        long long num_moves = 0, stall = 0;
+        uniform_real_distribution<double> coin(0.0, 1.0);
+        while (stall < max_stall) {
+            if (num_moves % 64 == 0) {
+                if (control->should_stop()) break;
+                if (!control->has_deadline && chrono::steady_clock::now() >= default_deadline) break;
+            }
+            num_moves++;
+
+            const int old_missing = num_missing;
+            const int old_makespan = get_makespan();
+            if (coin(rng) < 0.5) {
+                const int w = min(kLNSWindow, N);
+                const int lo = uniform_int_distribution<int>(0, N - w)(rng);
+                repair_window(lo, lo + w);
+            } else {
+                // Prefer incomplete tasks, and move them to where their start window closes.
+                int from = uniform_int_distribution<int>(0, N - 1)(rng);
+                for (int k = 0; k < 8 && ends[order[from]] >= 0; ++k) from = uniform_int_distribution<int>(0, N - 1)(rng);
+                int to;
+                const int t = order[from];
+                if (ends[t] < 0 && latest_start[t] < numeric_limits<int>::max()) {
+                    const int last_prev_end = latest_start[t] - tasks.rest_time;
+                    to = upper_bound(prefix_ends.begin(), prefix_ends.begin() + from, last_prev_end) - prefix_ends.begin();
+                } else {
+                    to = uniform_int_distribution<int>(max(0, from - kLNSMaxShift), min(N - 1, from + kLNSMaxShift))(rng);
+                }
+                if (from == to) continue;
+                relocate(from, to);
+            }
+            evaluate();
+
+            const int new_makespan = get_makespan();
+            if (num_missing > old_missing || (num_missing == old_missing && new_makespan > old_makespan)) {
+                undo_move();
+                stall++;
+            } else if (num_missing < old_missing || new_makespan < old_makespan) {
+                control->publish(num_missing, new_makespan);
+                stall = 0;
+            } else {
+                // Sideways moves are kept to get across plateaus.
+                stall++;
+            }
+        }
+        return num_moves;
+    }
+
+    ScheduleItem get_best() const {
+        ScheduleItem best(N);
+        for (int t = 0; t < N; ++t) {
+            best.end_timestamps[t] = ends[t];
+            if (ends[t] >= 0) best.num_scheduled++;
+        }
+        best.end_timestamp = best.num_scheduled > 0 ? get_makespan() : -1;
+        return best;
+    }
+};
+
+bool make_schedule_lns(const Tasks& tasks, SearchControl* control, Schedules* schedules) {
+    LNSSolver solver(tasks, control);
+    long long num_moves = solver.solve();
+
+	cout << "Local search finished. #Moves = " << num_moves << endl;
+
+    fill_schedules(tasks, solver.get_best(), num_moves, schedules);
+    schedules->engine = Tasks::LNS;
+    schedules->proven_optimal = false;
+    return true;
+}
+
+bool run_engine(Tasks::Engine engine, const Tasks& tasks, SearchControl* control, Schedules* schedules);
+
+// Race all engines on the same tasks. They share the incumbent, and the first one to prove
+// optimality stops the others.
+bool make_schedule_portfolio(const Tasks& tasks, SearchControl* control, Schedules* schedules) {
+    vector<Tasks::Engine> engines;
+    engines.push_back(Tasks::ASTAR);
+    if (tasks.tasks.size() <= kMaxDPTasks) engines.push_back(Tasks::DP);
+    engines.push_back(Tasks::LNS);
+
+    vector<Schedules> results(engines.size());
+    vector<thread> workers;
+    for (int e = 0; e < engines.size(); ++e) {
+        workers.push_back(thread([&, e]() { run_engine(engines[e], tasks, control, &results[e]); }));
+    }
+    for (auto& worker : workers) worker.join();
+
+    // The optimality proof of one engine covers the incumbent, i.e. the best of all results.
+    int winner = 0;
+    bool proven = false;
+    const int N = tasks.tasks.size();
+    for (int e = 0; e < results.size(); ++e) {
+        const Schedules& r = results[e];
+        const Schedules& w = results[winner];
+        long long key = SearchControl::get_key(N - r.schedules.size(), r.total_duration);
+        long long winner_key = SearchControl::get_key(N - w.schedules.size(), w.total_duration);
+        if (key < winner_key || (key == winner_key && r.proven_optimal && !w.proven_optimal)) winner = e;
+        proven = proven || r.proven_optimal;
+    }
+
+    *schedules = results[winner];
+    schedules->proven_optimal = proven;
+    return true;
+}
+
+bool run_engine(Tasks::Engine engine, const Tasks& tasks, SearchControl* control, Schedules* schedules) {
+    switch (engine) {
+        case Tasks::PORTFOLIO:
+            return make_schedule_portfolio(tasks, control, schedules);
+        case Tasks::DP:
+            if (tasks.tasks.size() <= kMaxDPTasks) return make_schedule_dp(tasks, control, schedules);
+            cout << "Too many tasks for the DP engine (" << tasks.tasks.size() << " > " << kMaxDPTasks << "), using A*" << endl;
+            return make_schedule_astar(tasks, control, schedules);
+        case Tasks::LNS:
+            return make_schedule_lns(tasks, control, schedules);
+        case Tasks::ASTAR:
+        default:
+            return make_schedule_astar(tasks, control, schedules);
+    }
+}
+
+/////////////////////////////////Decomposition////////////////////////////////////
+// Tasks are grouped by dependency (a task is in the same group as its pre-reqs). The groups
+// are sorted by the earliest time any of their tasks may start, and consecutive groups are
+// merged while they overlap in time. Two resulting blocks A < B are independent: every task
+// of A ends at the latest rest_time before any task of B may start, so the start of a task
+// of B is set by its own window no matter what was scheduled in A (and vice versa). Solving
+// each block on its own from global_start_time therefore gives each block's part of the best
+// joint schedule: the incomplete tasks add up, and the end is the end of the last non-empty block.
+
+// Earliest start and latest end of a task, following earliest_given_constraint.
+pair<long long, long long> get_time_span(const Tasks& tasks, const Task& task) {
+    const TimeSegment& time = task.time;
+    const long long unbounded = numeric_limits<long long>::max() / 2;
+    long long earliest_start = tasks.global_start_time;
+    long long latest_end = time.deadline > 0 ? time.deadline : unbounded;
+    if (!time.start_time_intervals.empty()) {
+        const pair<int, int>& first = time.start_time_intervals.front();
+        const pair<int, int>& last = time.start_time_intervals.back();
+        earliest_start = max(earliest_start, (long long)first.first);
+        // Windows are capped by the deadline (see Calendar).
+        if (last.second != numeric_limits<int>::max()) latest_end = min(latest_end, (long long)last.second + time.duration);
+    }
+    return make_pair(earliest_start, latest_end);
+}
+
+vector<vector<int> > get_independent_blocks(const Tasks& tasks) {
+    const int N = tasks.tasks.size();
+
+    // Union-find over dependencies.
+    vector<int> parent(N);
+    for (int i = 0; i < N; ++i) parent[i] = i;
+    auto find = [&](int i) {
+        while (parent[i] != i) i = parent[i] = parent[parent[i]];
+        return i;
+    };
+    for (const Task& task : tasks.tasks) {
+        for (int pre_index : task.pre_req_indices) parent[find(pre_index)] = find(task.idx);
+    }
+
+    map<int, int> group_of_root;
+    vector<vector<int> > groups;
+    vector<pair<long long, long long> > spans;
+    for (int i = 0; i < N; ++i) {
+        auto it = group_of_root.find(find(i));
+        if (it == group_of_root.end()) {
+            it = group_of_root.insert(make_pair(find(i), groups.size())).first;
+            groups.push_back(vector<int>());
+            spans.push_back(make_pair(numeric_limits<long long>::max(), numeric_limits<long long>::min()));
+        }
+        groups[it->second].push_back(i);
+        pair<long long, long long> span = get_time_span(tasks, tasks.tasks[i]);
+        spans[it->second].first = min(spans[it->second].first, span.first);
+        spans[it->second].second = max(spans[it->second].second, span.second);
+    }
+
+    vector<int> group_order(groups.size());
+    for (int g = 0; g < groups.size(); ++g) group_order[g] = g;
+    sort(group_order.begin(), group_order.end(), [&](int a, int b) { return spans[a] < spans[b]; });
+
+    vector<vector<int> > blocks;
+    long long block_end = 0;
+    for (int g : group_order) {
+        if (blocks.empty() || block_end + tasks.rest_time > spans[g].first) {
+            if (blocks.empty()) blocks.push_back(vector<int>());
+            blocks.back().insert(blocks.back().end(), groups[g].begin(), groups[g].end());
+            block_end = max(block_end, spans[g].second);
+        } else {
+            blocks.push_back(groups[g]);
+            block_end = spans[g].second;
+        }
+    }
+    for (auto& block : blocks) sort(block.begin(), block.end());
+    return blocks;
+}
+
+bool make_schedule_decomposed(const Tasks& tasks, const vector<vector<int> >& blocks, SearchControl* control, Schedules* schedules) {
+    cout << "Decomposed into " << blocks.size() << " independent blocks" << endl;
+
+    // Each block is a Tasks of its own, with task indices local to the block.
+    vector<Tasks> block_tasks(blocks.size(), tasks);
+    for (int b = 0; b < blocks.size(); ++b) {
+        vector<int> local_index(tasks.tasks.size(), -1);
+        for (int i = 0; i < blocks[b].size(); ++i) local_index[blocks[b][i]] = i;
+
+        Tasks& sub = block_tasks[b];
+        sub.tasks.clear();
+        for (int i = 0; i < blocks[b].size(); ++i) {
+            Task task = tasks.tasks[blocks[b][i]];
+            task.idx = i;
+            for (int& pre_index : task.pre_req_indices) pre_index = local_index[pre_index];
+            sub.tasks.push_back(task);
+        }
+    }
+
+    vector<Schedules> results(blocks.size());
+    atomic<int> next_block(0);
+    const int num_threads = min(max(tasks.num_threads, 1), (int)blocks.size());
+    auto worker = [&]() {
+        for (int b = next_block++; b < blocks.size(); b = next_block++) {
+            SearchControl block_control(block_tasks[b]);
+            block_control.has_deadline = control->has_deadline;
+            block_control.deadline = control->deadline;
+            block_control.compact_nodes = control->compact_nodes;
+            if (control->has_deadline) {
+                // Share what is left of the budget among the blocks not started yet, so that a hard
+                // block cannot use it all up and leave the later ones without a single step. Time a
+                // block does not use goes to the blocks after it.
+                const int blocks_left = blocks.size() - b;
+                const int rounds_left = (blocks_left + num_threads - 1) / num_threads;
+                const chrono::steady_clock::time_point now = chrono::steady_clock::now();
+                if (now < control->deadline) block_control.deadline = now + (control->deadline - now) / rounds_left;
+            }
+            run_engine(tasks.engine, block_tasks[b], &block_control, &results[b]);
+        }
+    };
+    vector<thread> workers;
+    for (int t = 1; t < num_threads; ++t) workers.push_back(thread(worker));
+    worker();
+    for (auto& w : workers) w.join();
+
+    // Blocks are in time order, so their schedules can simply be concatenated.
     schedules->schedules.clear();
-    int duration = 0;
-    for (int i = 0; i < order.size(); ++i) {
-        Schedule s;
+    schedules->incomplete_tasks.clear();
+    schedules->search_steps = 0;
+    schedules->used_duration = 0;
+    schedules->proven_optimal = true;
+    // Report the engine the blocks agree on. With the portfolio they may not, and then the
+    // engine that solved the largest block (the earliest one on a tie) is reported.
+    int largest_block = 0;
+    for (int b = 1; b < blocks.size(); ++b) {
+        if (blocks[b].size() > blocks[largest_block].size()) largest_block = b;
+    }
+    schedules->engine = results[largest_block].engine;
+    time_t end_timestamp = -1;
+    for (int b = 0; b < blocks.size(); ++b) {
+        const Schedules& r = results[b];
+        for (Schedule s : r.schedules) {
+            s.idx = blocks[b][s.idx];
+            schedules->schedules.push_back(s);
+        }
+        for (int idx : r.incomplete_tasks) schedules->incomplete_tasks.push_back(blocks[b][idx]);
+        if (!r.schedules.empty()) end_timestamp = r.total_duration + tasks.global_start_time;
+        schedules->search_steps += r.search_steps;
+        schedules->used_duration += r.used_duration;
+        schedules->proven_optimal = schedules->proven_optimal && r.proven_optimal;
+        schedules->spill_bytes_written += r.spill_bytes_written;
+        schedules->spill_bytes_read += r.spill_bytes_read;
+    }
+    sort(schedules->incomplete_tasks.begin(), schedules->incomplete_tasks.end());
+    schedules->status = schedules->incomplete_tasks.empty() ? Schedules::FinalStatus::SUCCESS : Schedules::FinalStatus::INCOMPLETE;
+    schedules->total_duration = end_timestamp - tasks.global_start_time;
+    return true;
+}
 
-        const int task_index = order[i];
-        const Task& task = tasks.tasks[task_index];
+/////////////////////////////////Compact nodes////////////////////////////////////
+// A* stores one end time per task in every node. With compact_nodes the search runs on a copy
+// of the tasks in which every time is a number of ticks since an origin, so that the end times
+// fit in 16 bits. The origin is global_start_time rounded up to time_quantum: the current time
+// has seconds, the times of the tasks usually do not. The tick is time_quantum, reduced to the
+// gcd of all durations, cool downs, rest time and window bounds/deadlines (relative to the
+// origin), so that it only gets shorter when the tasks themselves use seconds. Apart from not
+// starting before the origin the schedule is the same. If the latest possible end does not
+// fit, the search runs on the original tasks.
+
+int get_gcd(int a, int b) {
+    a = abs(a);
+    b = abs(b);
+    while (b > 0) {
+        int r = a % b;
+        a = b;
+        b = r;
+    }
+    return a;
+}
 
-        s.idx = task.idx;
-        s.end = best_schedule.end_timestamps[task_index];        
-        s.start = s.end - task.time.duration;
-        // Add the schedule into the scheduler.
-        schedules->schedules.push_back(s);
+bool make_compact_tasks(const Tasks& tasks, Tasks* compact, int* quantum, int* origin) {
+    const int unbounded = numeric_limits<int>::max();
+    int q = max(tasks.time_quantum, 1);
+    const int G = (tasks.global_start_time + q - 1) / q * q;
+    q = get_gcd(q, tasks.rest_time);
+    // Every task ends at the latest after the last window opens and all tasks ran back to back.
+    long long latest_open = G, total = 0;
+    for (const Task& task : tasks.tasks) {
+        const TimeSegment& time = task.time;
+        q = get_gcd(q, get_gcd(time.duration, time.cool_down));
+        if (time.deadline > 0) q = get_gcd(q, time.deadline - G);
+        for (const auto& interval : time.start_time_intervals) {
+            // kNoStart stays as it is.
+            if (interval.second < interval.first) continue;
+            q = get_gcd(q, interval.first - G);
+            if (interval.second != unbounded) q = get_gcd(q, interval.second - G);
+            latest_open = max(latest_open, (long long)interval.first);
+        }
+        total += (long long)time.duration + time.cool_down + tasks.rest_time;
+    }
+    if ((latest_open + total - G) / q > numeric_limits<int16_t>::max()) return false;
+
+    *compact = tasks;
+    compact->global_start_time = 0;
+    compact->rest_time = tasks.rest_time / q;
+    for (Task& task : compact->tasks) {
+        TimeSegment& time = task.time;
+        time.duration /= q;
+        time.cool_down /= q;
+        if (time.deadline > 0) {
+            time.deadline = (time.deadline - G) / q;
+            // A deadline at or before the start time would read as no deadline.
+            if (time.deadline <= 0) return false;
+        }
+        for (auto& interval : time.start_time_intervals) {
+            if (interval.second < interval.first) continue;
+            interval.first = (interval.first - G) / q;
+            if (interval.second != unbounded) interval.second = (interval.second - G) / q;
+        }
+    }
+    *quantum = q;
+    *origin = G;
+    return true;
+}
 
-        duration += task.time.duration;
+// Convert a schedule of the compact tasks back to seconds.
+void expand_compact_schedules(const Tasks& tasks, int quantum, int origin, Schedules* schedules) {
+    for (Schedule& s : schedules->schedules) {
+        s.start = s.start * quantum + origin;
+        s.end = s.end * quantum + origin;
     }
+    // total_duration is counted from global_start_time.
+    if (schedules->schedules.empty()) schedules->total_duration = -1 - tasks.global_start_time;
+    else schedules->total_duration = schedules->total_duration * quantum + origin - tasks.global_start_time;
+    schedules->used_duration *= quantum;
+}
 
-    schedules->used_duration = duration;
+bool make_schedule_ticks(const Tasks& tasks, SearchControl* control, Schedules* schedules) {
+    if (tasks.decompose) {
+        vector<vector<int> > blocks = get_independent_blocks(tasks);
+        if (blocks.size() > 1) return make_schedule_decomposed(tasks, blocks, control, schedules);
+    }
+    return run_engine(tasks.engine, tasks, control, schedules);
+}
+
+// Input a few tasks and return a complete schedule.
+bool make_schedule(const Tasks& input, Schedules* schedules) {
+    // The engines need sorted, disjoint windows. build_calendar keeps them as they are if the
+    // caller already built the calendar.
+    Tasks tasks = input;
+    build_calendar(&tasks);
+
+    SearchControl control(tasks);
+    if (tasks.compact_nodes) {
+        Tasks compact;
+        int quantum, origin;
+        if (make_compact_tasks(tasks, &compact, &quantum, &origin)) {
+            cout << "Compact nodes: tick = " << quantum << "s from " << convert_to_time(origin) << endl;
+            control.compact_nodes = true;
+            if (!make_schedule_ticks(compact, &control, schedules)) return false;
+            expand_compact_schedules(tasks, quantum, origin, schedules);
+            return true;
+        }
+        cout << "Compact nodes: the schedule does not fit in 16 bits, using full timestamps" << endl;
+    }
+    return make_schedule_ticks(tasks, &control, schedules);
+}
+
+/////////////////////////////////Robustness///////////////////////////////////////
+// Replays a schedule with random slips. Every task keeps its place in the schedule and starts
+// at the latest of its planned start (moved by up to +-uncertainty for tasks with ~), the end of
+// the previous task plus rest time, and the ends of its pre-reqs plus their cool down. Its
+// duration is scaled by a uniform factor in [1 - duration_noise, 1 + duration_noise]. Samples
+// are processed in blocks with one sample per SIMD lane (see schedule_kernel.h), and the blocks
+// are spread over the threads. Each block has its own seed, so the result does not depend on
+// the number of threads.
+
+const int kRobustnessBlock = 1024;
+
+// xorshift, uniform in [-1, 1).
+struct LaneRandom {
+    uint64_t state;
+
+    LaneRandom(uint64_t seed) : state(seed * 0x9E3779B97F4A7C15ull + 1) {
+    }
+
+    float next() {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return (state >> 40) * (2.0f / (1 << 24)) - 1.0f;
+    }
+
+    void fill(int n, float center, float scale, float* x) {
+        if (scale == 0) {
+            std::fill(x, x + n, center);
+            return;
+        }
+        for (int s = 0; s < n; ++s) x[s] = center + scale * next();
+    }
+};
+
+bool evaluate_robustness(const Tasks& tasks, const Schedules& schedules, Robustness* robustness) {
+    const auto start_time = chrono::steady_clock::now();
+    const int M = schedules.schedules.size();
+    const int S = tasks.robustness_samples;
+    robustness->num_samples = S;
+    robustness->deadline_miss.assign(M, 0);
+    if (M == 0 || S <= 0) return false;
+
+    // Pre-reqs are scheduled before the task.
+    vector<int> position(tasks.tasks.size(), -1);
+    for (int k = 0; k < M; ++k) position[schedules.schedules[k].idx] = k;
+
+    const int B = kRobustnessBlock;
+    const int num_blocks = (S + B - 1) / B;
+    vector<float> makespans(S);
+    vector<vector<int> > misses(num_blocks, vector<int>(M, 0));
+
+    atomic<int> next_block(0);
+    auto worker = [&]() {
+        vector<float> ends((size_t)M * B), ready(B), jitter(B), factor(B);
+        for (int b = next_block++; b < num_blocks; b = next_block++) {
+            const int n = min(B, S - b * B);
+            LaneRandom rng(b + 1);
+            for (int k = 0; k < M; ++k) {
+                const Schedule& planned = schedules.schedules[k];
+                const Task& task = tasks.tasks[planned.idx];
+                float* end = &ends[(size_t)k * B];
+
+                if (k == 0) std::fill(ready.begin(), ready.begin() + n, (float)(tasks.global_start_time + tasks.rest_time));
+                else {
+                    std::fill(ready.begin(), ready.begin() + n, numeric_limits<float>::lowest());
+                    max_add_lanes(n, &ends[(size_t)(k - 1) * B], tasks.rest_time, ready.data());
+                }
+                for (int pre_index : task.pre_req_indices) {
+                    if (position[pre_index] < 0) continue;
+                    max_add_lanes(n, &ends[(size_t)position[pre_index] * B], tasks.tasks[pre_index].time.cool_down, ready.data());
+                }
+                rng.fill(n, 0, task.time.uncertainty, jitter.data());
+                rng.fill(n, 1, tasks.duration_noise, factor.data());
+                finish_lanes(n, planned.start, jitter.data(), ready.data(), task.time.duration, factor.data(), end);
+
+                if (task.time.deadline > 0) {
+                    int num_missed = 0;
+                    for (int s = 0; s < n; ++s) num_missed += end[s] > task.time.deadline;
+                    misses[b][k] = num_missed;
+                }
+            }
+            // Each task ends after the previous one.
+            const float* last = &ends[(size_t)(M - 1) * B];
+            for (int s = 0; s < n; ++s) makespans[b * B + s] = last[s] - tasks.global_start_time;
+        }
+    };
+    const int num_threads = min(max(tasks.num_threads, 1), num_blocks);
+    vector<thread> workers;
+    for (int t = 1; t < num_threads; ++t) workers.push_back(thread(worker));
+    worker();
+    for (auto& w : workers) w.join();
+
+    for (int b = 0; b < num_blocks; ++b) {
+        for (int k = 0; k < M; ++k) robustness->deadline_miss[k] += misses[b][k];
+    }
+    for (float& p : robustness->deadline_miss) p /= S;
+
+    auto percentile = [&](float q) {
+        auto it = makespans.begin() + min(S - 1, (int)(q * S));
+        nth_element(makespans.begin(), it, makespans.end());
+        return (int)*it;
+    };
+    robustness->makespan_p50 = percentile(0.5);
+    robustness->makespan_p90 = percentile(0.9);
+    robustness->makespan_p99 = percentile(0.99);
+
+    const double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start_time).count();
+    cout << "Robustness finished. #Samples = " << S << " Kernel = " << get_kernel_name() << " Time = " << ms << "ms" << endl;
     return true;
 }
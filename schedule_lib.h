@@ -39,16 +39,20 @@ struct TimeSegment {
 
     // The starting time of this task falls in the union of [e_i, l_i].
     // if it is empty, then there is no such constraint.
+    // Sorted and disjoint after build_calendar.
     std::vector<std::pair<int, int> > start_time_intervals;
 
     // Priority (1-10).
     int priority;
 
+    // Uncertainty of the starting time (~).
+    int uncertainty;
+
     // The original patterns.
     std::string pattern;
 
     // Default Constructor
-    TimeSegment() : duration(0), cool_down(0), deadline(-1), priority(10)  { }
+    TimeSegment() : duration(0), cool_down(0), deadline(-1), priority(10), uncertainty(0)  { }
     std::string get_summary() const {
         std::stringstream ss;
         ss << "[" << pattern << "]";
@@ -56,6 +60,7 @@ struct TimeSegment {
         ss << "dur=" << duration << ",";
         ss << "cd=" << cool_down << ",";
         if (deadline >= 0) ss << "ddl=" << deadline << ",";
+        if (uncertainty > 0) ss << "unc=" << uncertainty << ",";
 
         if (!start_time_intervals.empty()) {
             ss << "int=";
@@ -94,19 +99,62 @@ struct Task {
 };
 
 struct Tasks {
+    // ASTAR: best-first search, bounded by max_heap_size.
+    // DP: exact dynamic programming over subsets of tasks (at most 20 tasks).
+    // PORTFOLIO: run all engines concurrently, sharing the best schedule found so far.
+    // LNS: large-neighbourhood local search, for plans with thousands of tasks.
+    enum Engine { ASTAR = 0, DP = 1, PORTFOLIO = 2, LNS = 3 };
+
     std::vector<Task> tasks;
 
+    // Busy time (meetings, lunch) that no task may overlap, as [start, end).
+    std::vector<std::pair<int, int> > busy_intervals;
+
     // Scheduling parameters.
     int global_start_time;
     int rest_time;
     int max_heap_size;
 
-    Tasks() : global_start_time(0), rest_time(0), max_heap_size(500000) { } 
+    // Partial-expansion A*: only queue the children whose f-value matches the parent's.
+    bool partial_expansion;
+
+    // Write the nodes over max_heap_size to a temporary file instead of dropping them, so that
+    // A* stays complete with bounded memory.
+    bool spill_open_list;
+
+    Engine engine;
+    int num_threads;
+
+    // Return the best schedule found so far after this long (0: no limit).
+    int time_budget_ms;
+
+    // Solve groups of tasks that cannot interact (no shared dependencies, disjoint time windows) separately.
+    bool decompose;
+
+    // A* keeps the end times of a node in 16-bit ticks of time_quantum seconds (or a divisor of it)
+    // when the schedule fits, which makes nodes about 4x smaller.
+    bool compact_nodes;
+    int time_quantum;
+
+    // Replay the schedule this many times with random slips (0: off), see evaluate_robustness.
+    // Durations vary by up to duration_noise (relative).
+    int robustness_samples;
+    float duration_noise;
+
+    Tasks() : global_start_time(0), rest_time(0), max_heap_size(500000), partial_expansion(true), spill_open_list(false), engine(ASTAR), num_threads(1), time_budget_ms(0), decompose(true), compact_nodes(false), time_quantum(60), robustness_samples(0), duration_noise(0.1f) { } 
     std::string get_summary() const {
         std::stringstream ss;
         ss << "Start time: " << global_start_time << std::endl;
         ss << "Rest time: " << rest_time << std::endl;
+        for (const auto& b : busy_intervals) ss << "Busy: " << b.first << "-" << b.second << std::endl;
         ss << "Max Heap size: " << max_heap_size << std::endl;
+        ss << "Partial expansion: " << partial_expansion << std::endl;
+        if (spill_open_list) ss << "Spill open list: " << spill_open_list << std::endl;
+        ss << "Engine: " << engine << std::endl;
+        ss << "#Threads: " << num_threads << std::endl;
+        if (time_budget_ms > 0) ss << "Time budget: " << time_budget_ms << "ms" << std::endl;
+        if (compact_nodes) ss << "Compact nodes: " << time_quantum << "s" << std::endl;
+        if (robustness_samples > 0) ss << "Robustness: " << robustness_samples << " samples, duration noise " << duration_noise << std::endl;
         for (int i = 0; i < tasks.size(); ++i) ss << tasks[i].get_summary();
         return ss.str();
     }
@@ -128,10 +176,37 @@ struct Schedules {
     FinalStatus status;
     std::vector<int> incomplete_tasks;
     int total_duration, used_duration;
+
+    // The engine that found the schedule, and whether it is known to be the best one.
+    Tasks::Engine engine;
+    bool proven_optimal;
+
+    // Disk traffic of the A* open list (see Tasks::spill_open_list).
+    long long spill_bytes_written = 0, spill_bytes_read = 0;
 };
 
+// Index the start windows of every task, removing the starts that overlap busy time or miss
+// the deadline.
+void build_calendar(Tasks* tasks);
+
+// Builds the calendar on its own copy of the tasks first.
 bool make_schedule(const Tasks& tasks, Schedules* schedules);
 
+// How a schedule holds up when starts and durations slip.
+struct Robustness {
+    int num_samples;
+
+    // For each entry of Schedules::schedules, the fraction of samples that miss its deadline.
+    std::vector<float> deadline_miss;
+
+    // Percentiles of the end of the schedule, in seconds after the start time.
+    int makespan_p50, makespan_p90, makespan_p99;
+};
+
+bool evaluate_robustness(const Tasks& tasks, const Schedules& schedules, Robustness* robustness);
+
 std::string convert_to_time(int t); 
 
+std::string get_engine_name(Tasks::Engine engine);
+
 #endif
@@ -0,0 +1,222 @@
+/*
+Copyright (c) 2016 by Yuandong Tian
+
+Permission is hereby granted, free of charge, to any person obtaining a copy 
+of this software and associated documentation files (the "Software"), to deal 
+in the Software without restriction, including without limitation the rights 
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies 
+of the Software, and to permit persons to whom the Software is furnished to do so, 
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included 
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL 
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "schedule_output.h"
+
+#include <cstring>
+#include <unistd.h>
+
+using namespace std;
+
+char* write_int(char* p, long long v, int width) {
+    char digits[24];
+    int n = 0;
+    unsigned long long u = v < 0 ? -(unsigned long long)v : v;
+    do {
+        digits[n++] = '0' + u % 10;
+        u /= 10;
+    } while (u > 0);
+    // The fill goes before the sign, as with iostreams.
+    for (int len = n + (v < 0); len < width; ++len) *p++ = '0';
+    if (v < 0) *p++ = '-';
+    while (n > 0) *p++ = digits[--n];
+    return p;
+}
+
+char* write_time(char* p, int t) {
+    int hour = t / 3600;
+    int minute = (t - hour * 3600) / 60;
+    p = write_int(p, hour, 2);
+    *p++ = ':';
+    return write_int(p, minute, 2);
+}
+
+ScheduleWriter::ScheduleWriter(Format format, int fd, size_t buffer_size)
+    : m_format(format), m_fd(fd), m_buffer(buffer_size), m_size(0), m_num_written(0) {
+}
+
+ScheduleWriter::~ScheduleWriter() {
+    Flush();
+}
+
+bool ScheduleWriter::ParseFormat(const string& name, Format* format) {
+    if (name == "table") *format = TABLE;
+    else if (name == "json") *format = JSON;
+    else if (name == "csv") *format = CSV;
+    else if (name == "binary") *format = BINARY;
+    else return false;
+    return true;
+}
+
+bool ScheduleWriter::Flush() {
+    size_t done = 0;
+    while (done < m_size) {
+        ssize_t n = ::write(m_fd, m_buffer.data() + done, m_size - done);
+        if (n <= 0) {
+            m_size = 0;
+            return false;
+        }
+        done += n;
+    }
+    m_size = 0;
+    return true;
+}
+
+char* ScheduleWriter::Reserve(size_t n) {
+    if (m_size + n > m_buffer.size()) {
+        Flush();
+        if (n > m_buffer.size()) m_buffer.resize(n);
+    }
+    return m_buffer.data() + m_size;
+}
+
+void ScheduleWriter::Append(const char* s, size_t n) {
+    memcpy(Reserve(n), s, n);
+    m_size += n;
+}
+
+void ScheduleWriter::AppendInt(long long v) {
+    char* p = Reserve(24);
+    m_size = write_int(p, v) - m_buffer.data();
+}
+
+// Quoted, with the escapes of the format.
+void ScheduleWriter::AppendString(const string& s) {
+    static const char* hex = "0123456789abcdef";
+    char* const begin = Reserve(6 * s.size() + 2);
+    char* p = begin;
+    *p++ = '"';
+    for (unsigned char c : s) {
+        if (m_format == CSV) {
+            if (c == '"') *p++ = '"';
+            *p++ = c;
+        } else if (c == '"' || c == '\\') {
+            *p++ = '\\';
+            *p++ = c;
+        } else if (c < 0x20) {
+            memcpy(p, "\\u00", 4);
+            p[4] = hex[c >> 4];
+            p[5] = hex[c & 15];
+            p += 6;
+        } else {
+            *p++ = c;
+        }
+    }
+    *p++ = '"';
+    m_size += p - begin;
+}
+
+#define APPEND_LITERAL(s) Append(s, sizeof(s) - 1)
+
+void ScheduleWriter::WriteJSON(const Tasks& tasks, const Schedules& schedules) {
+    APPEND_LITERAL("{\"status\":");
+    AppendString(schedules.status == Schedules::FinalStatus::SUCCESS ? "success" : "incomplete");
+    APPEND_LITERAL(",\"engine\":");
+    AppendString(get_engine_name(schedules.engine));
+    if (schedules.proven_optimal) APPEND_LITERAL(",\"optimal\":true");
+    else APPEND_LITERAL(",\"optimal\":false");
+    APPEND_LITERAL(",\"steps\":");
+    AppendInt(schedules.search_steps);
+    APPEND_LITERAL(",\"used_duration\":");
+    AppendInt(schedules.used_duration);
+    APPEND_LITERAL(",\"total_duration\":");
+    AppendInt(schedules.total_duration);
+    APPEND_LITERAL(",\"utility_pct\":");
+    AppendInt(schedules.total_duration > 0 ? 100 * schedules.used_duration / schedules.total_duration : 0);
+    APPEND_LITERAL(",\"schedules\":[");
+    for (int i = 0; i < schedules.schedules.size(); ++i) {
+        const Schedule& s = schedules.schedules[i];
+        if (i > 0) APPEND_LITERAL(",");
+        APPEND_LITERAL("{\"idx\":");
+        AppendInt(s.idx);
+        APPEND_LITERAL(",\"name\":");
+        AppendString(tasks.tasks[s.idx].name);
+        APPEND_LITERAL(",\"start\":");
+        AppendInt(s.start);
+        APPEND_LITERAL(",\"end\":");
+        AppendInt(s.end);
+        APPEND_LITERAL("}");
+    }
+    APPEND_LITERAL("],\"incomplete\":[");
+    for (int i = 0; i < schedules.incomplete_tasks.size(); ++i) {
+        const int idx = schedules.incomplete_tasks[i];
+        if (i > 0) APPEND_LITERAL(",");
+        APPEND_LITERAL("{\"idx\":");
+        AppendInt(idx);
+        APPEND_LITERAL(",\"name\":");
+        AppendString(tasks.tasks[idx].name);
+        APPEND_LITERAL("}");
+    }
+    APPEND_LITERAL("]}\n");
+}
+
+void ScheduleWriter::WriteCSV(const Tasks& tasks, const Schedules& schedules) {
+    if (m_num_written == 0) APPEND_LITERAL("schedule,idx,name,status,start,end,used_duration,total_duration\n");
+    // Times are in seconds of the day, empty for incomplete tasks.
+    auto row = [&](int idx, bool scheduled, int start, int end) {
+        AppendInt(m_num_written);
+        APPEND_LITERAL(",");
+        AppendInt(idx);
+        APPEND_LITERAL(",");
+        AppendString(tasks.tasks[idx].name);
+        if (scheduled) {
+            APPEND_LITERAL(",scheduled,");
+            AppendInt(start);
+            APPEND_LITERAL(",");
+            AppendInt(end);
+            APPEND_LITERAL(",");
+        } else {
+            APPEND_LITERAL(",incomplete,,,");
+        }
+        AppendInt(schedules.used_duration);
+        APPEND_LITERAL(",");
+        AppendInt(schedules.total_duration);
+        APPEND_LITERAL("\n");
+    };
+    for (const Schedule& s : schedules.schedules) row(s.idx, true, s.start, s.end);
+    for (int idx : schedules.incomplete_tasks) row(idx, false, 0, 0);
+}
+
+void ScheduleWriter::WriteBinary(const Schedules& schedules) {
+    const int header[] = {
+        kBinaryMagic, (int)schedules.schedules.size(), (int)schedules.incomplete_tasks.size(),
+        schedules.status, schedules.engine, schedules.proven_optimal,
+        schedules.search_steps, schedules.total_duration, schedules.used_duration
+    };
+    Append((const char*)header, sizeof(header));
+    for (const Schedule& s : schedules.schedules) {
+        const int record[] = { s.idx, s.start, s.end };
+        Append((const char*)record, sizeof(record));
+    }
+    if (!schedules.incomplete_tasks.empty()) {
+        Append((const char*)schedules.incomplete_tasks.data(), schedules.incomplete_tasks.size() * sizeof(int));
+    }
+}
+
+void ScheduleWriter::Write(const Tasks& tasks, const Schedules& schedules) {
+    switch (m_format) {
+        case JSON: WriteJSON(tasks, schedules); break;
+        case CSV: WriteCSV(tasks, schedules); break;
+        case BINARY: WriteBinary(schedules); break;
+        case TABLE: break;
+    }
+    m_num_written++;
+}
@@ -0,0 +1,77 @@
+/*
+Copyright (c) 2016 by Yuandong Tian
+
+Permission is hereby granted, free of charge, to any person obtaining a copy 
+of this software and associated documentation files (the "Software"), to deal 
+in the Software without restriction, including without limitation the rights 
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies 
+of the Software, and to permit persons to whom the Software is furnished to do so, 
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included 
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL 
+THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef _SCHEDULE_OUTPUT_H_
+#define _SCHEDULE_OUTPUT_H_
+
+#include <string>
+#include <vector>
+#include "schedule_lib.h"
+
+// Text of an integer, zero padded to width (like setfill('0') << setw(width)). Returns the end.
+char* write_int(char* p, long long v, int width = 0);
+
+// hh:mm, as convert_to_time. Returns the end.
+char* write_time(char* p, int t);
+
+// Machine-readable output of schedules. Records are formatted into a preallocated buffer
+// without iostreams, and the buffer goes out with a single write() per batch (Flush), or
+// earlier if it is full.
+//
+// JSON: one object per schedule and line.
+// CSV: one row per task (scheduled or not), after a header row.
+// BINARY: per schedule, int32 fields in host byte order:
+//   magic (kBinaryMagic), #scheduled, #incomplete, status, engine, proven_optimal,
+//   search_steps, total_duration, used_duration,
+//   then (idx, start, end) for each scheduled task and idx for each incomplete task.
+class ScheduleWriter {
+public:
+    enum Format { TABLE = 0, JSON = 1, CSV = 2, BINARY = 3 };
+    static const int kBinaryMagic = 0x44484353;
+
+    ScheduleWriter(Format format, int fd = 1, size_t buffer_size = 1 << 16);
+    ~ScheduleWriter();
+
+    static bool ParseFormat(const std::string& name, Format* format);
+
+    // Append one schedule of the batch (not for TABLE).
+    void Write(const Tasks& tasks, const Schedules& schedules);
+    bool Flush();
+
+private:
+    Format m_format;
+    int m_fd;
+    std::vector<char> m_buffer;
+    size_t m_size;
+    int m_num_written;
+
+    // Make room for n more bytes.
+    char* Reserve(size_t n);
+    void Append(const char* s, size_t n);
+    void AppendInt(long long v);
+    void AppendString(const std::string& s);
+
+    void WriteJSON(const Tasks& tasks, const Schedules& schedules);
+    void WriteCSV(const Tasks& tasks, const Schedules& schedules);
+    void WriteBinary(const Schedules& schedules);
+};
+
+#endif